@@ -0,0 +1,27 @@
+# target instruction set of the vectorised kernels (layout conversions, dense
+# layers of native_mlp), which otherwise build their portable loops: the
+# library then only runs on CPUs supporting it
+set( INFERO_SIMD "none" CACHE STRING "Instruction set of the vectorised kernels: none|native|avx2|avx512" )
+set_property( CACHE INFERO_SIMD PROPERTY STRINGS none native avx2 avx512 )
+
+if( INFERO_SIMD STREQUAL "native" )
+  set( INFERO_SIMD_FLAGS -march=native )
+elseif( INFERO_SIMD STREQUAL "avx2" )
+  set( INFERO_SIMD_FLAGS -mavx2 -mfma )
+elseif( INFERO_SIMD STREQUAL "avx512" )
+  set( INFERO_SIMD_FLAGS -mavx2 -mfma -mavx512f )
+elseif( NOT INFERO_SIMD STREQUAL "none" )
+  ecbuild_critical( "INFERO_SIMD must be one of none|native|avx2|avx512, found ${INFERO_SIMD}" )
+endif()
+
+if( INFERO_SIMD_FLAGS )
+
+  include( CheckCXXCompilerFlag )
+  string( REPLACE ";" " " _infero_simd_flags "${INFERO_SIMD_FLAGS}" )
+  check_cxx_compiler_flag( "${_infero_simd_flags}" INFERO_SIMD_${INFERO_SIMD}_SUPPORTED )
+  if( NOT INFERO_SIMD_${INFERO_SIMD}_SUPPORTED )
+    ecbuild_critical( "INFERO_SIMD=${INFERO_SIMD}: ${_infero_simd_flags} not supported by the compiler" )
+  endif()
+
+  ecbuild_info( "Vectorised kernels built for ${INFERO_SIMD} (${_infero_simd_flags})" )
+endif()
@@ -65,10 +65,17 @@ int main(int argc, char** argv) {
     std::string name_input2 = argv[4];
     std::string name_output = argv[5];
 
-    // Model configuration from CL
+    // N threads running inference concurrently
+    size_t nThreads=10;
+
+    // Model configuration from CL (one backend session per thread)
+    eckit::LocalConfiguration model_config;
+    model_config.set("numSessions", std::to_string(nThreads));
+
     eckit::LocalConfiguration local;
     local.set("path", model_path);
     local.set("type", model_type);
+    local.set("model_config", model_config);
 
     // N batches
     size_t batchSize = 3;
@@ -122,7 +129,6 @@ int main(int argc, char** argv) {
     output_map.insert(make_pair(name_output, t3));
 
 
-    size_t nThreads=10;
     std::vector<std::thread> threads;
     for (size_t iThread=0; iThread<nThreads; iThread++) {
       threads.push_back( std::thread( run_inference, engine, input_map, output_map ) );
@@ -0,0 +1,125 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/runtime/Main.h"
+
+#include "infero/models/DenseKernels.h"
+#include "infero/models/InferenceModel.h"
+
+
+using namespace infero;
+
+
+/// mean time (us) of one inference of batch rows
+double time_inference(InferenceModel& engine, size_t batch, size_t nInputs, size_t nOutputs) {
+
+    std::vector<size_t> in_shape{batch, nInputs};
+    std::vector<size_t> out_shape{batch, nOutputs};
+    eckit::linalg::TensorFloat tIn(in_shape, eckit::linalg::TensorFloat::Layout::RowMajor);
+    eckit::linalg::TensorFloat tOut(out_shape, eckit::linalg::TensorFloat::Layout::RowMajor);
+
+    for (size_t i = 0; i < tIn.size(); i++) {
+        *(tIn.data() + i) = static_cast<float>(i % 100) / 100.f;
+    }
+
+    // warm-up (and first-call allocations)
+    engine.infer(tIn, tOut);
+
+    // about 10^8 input values per measurement, at least 10 calls
+    size_t nIter = std::max<size_t>(10, 100000000 / tIn.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nIter; i++) {
+        engine.infer(tIn, tOut);
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / nIter;
+}
+
+
+//// ==============================================================================================================
+//// Example usage (orographic drag emulator, native engine against ONNX), with the activations printed by the script:
+//// > python <infero-sources-path>/scripts/convert_keras2npz.py model_36966.h5 model.npz
+//// > ./bin/5_benchmark_mlp --activations=relu,relu,linear 191 126 native_mlp model.npz \
+////       onnx <infero-sources-path>/tests/data/orographic_drag/model.onnx
+//// ==============================================================================================================
+int main(int argc, char** argv) {
+
+    eckit::Main::initialise(argc, argv);
+
+    // activations of the native_mlp models (as printed by convert_keras2npz.py)
+    std::string activations;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--activations=", 0) == 0) {
+            activations = arg.substr(std::string("--activations=").size());
+        }
+        else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() < 4 || args.size() % 2 != 0) {
+        printf("Error: This example must be invoked as: \n");
+        printf("<infero-build-path>/bin/5_benchmark_mlp [--activations=<native_mlp activations>] ");
+        printf("<n-inputs> <n-outputs> <model-type> <model-path> [<model-type> <model-path> ...]\n");
+        return 1;
+    }
+
+    size_t nInputs  = std::stoul(args[0]);
+    size_t nOutputs = std::stoul(args[1]);
+
+    std::vector<size_t> batches{1, 10, 100, 1000, 10000};
+
+    // (the native engine is only vectorised in an INFERO_SIMD build)
+    printf("native_mlp dense kernel: %s\n\n", mlp::vectorised() ? "AVX2/FMA" : "portable (see INFERO_SIMD)");
+
+    printf("%-12s", "batch");
+    for (size_t b : batches) {
+        printf("%12zu", b);
+    }
+    printf("   (us per inference)\n");
+
+    for (size_t iarg = 2; iarg < args.size(); iarg += 2) {
+
+        std::string model_type = args[iarg];
+        std::string model_path = args[iarg + 1];
+
+        eckit::LocalConfiguration local;
+        local.set("path", model_path);
+        local.set("type", model_type);
+
+        if (model_type == "native_mlp" && !activations.empty()) {
+            eckit::LocalConfiguration model_config;
+            model_config.set("activations", activations);
+            local.set("model_config", model_config);
+        }
+
+        std::unique_ptr<InferenceModel> engine(InferenceModelFactory::instance().build(model_type, local));
+
+        printf("%-12s", model_type.c_str());
+        for (size_t b : batches) {
+            printf("%12.1f", time_inference(*engine, b, nInputs, nOutputs));
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
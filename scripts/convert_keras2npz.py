@@ -0,0 +1,55 @@
+#
+# (C) Copyright 1996- ECMWF.
+#
+# This software is licensed under the terms of the Apache Licence Version 2.0
+# which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+# In applying this licence, ECMWF does not waive the privileges and immunities
+# granted to it by virtue of its status as an intergovernmental organisation
+# nor does it submit to any jurisdiction.
+#
+
+import numpy as np
+import argparse
+import keras
+
+
+if __name__ == "__main__":
+    """
+    Lightweight script to export the Dense layers of a keras model
+    for the native_mlp engine (kernel_<i>, bias_<i> arrays of a .npz)
+    """
+
+    parser = argparse.ArgumentParser("Keras to native MLP")
+    parser.add_argument('keras_model_path', help="Path of the input keras model")
+    parser.add_argument('npz_model_path', help="Path of the output npz model")
+
+    args = parser.parse_args()
+
+    # load the keras model
+    model = keras.models.load_model(args.keras_model_path)
+    model.summary()
+
+    arrays = {}
+    activations = []
+    for layer in model.layers:
+
+        if isinstance(layer, keras.layers.InputLayer):
+            continue
+
+        if not isinstance(layer, keras.layers.Dense):
+            raise ValueError("Layer {} ({}) is not Dense".format(layer.name, type(layer).__name__))
+
+        kernel, bias = layer.get_weights()
+        i = len(activations)
+        arrays["kernel_{}".format(i)] = kernel.astype(np.float32)
+        arrays["bias_{}".format(i)] = bias.astype(np.float32)
+        activations.append(layer.get_config()["activation"])
+
+    # (a single name sets the hidden layers only, a single layer model is linear)
+    if len(activations) == 1 and activations[0] != "linear":
+        raise ValueError("A single Dense layer must be linear, found {}".format(activations[0]))
+
+    np.savez(args.npz_model_path, **arrays)
+
+    # to be set as model_config "activations"
+    print("activations: {}".format(",".join(activations)))
@@ -15,6 +15,8 @@
 #include <map>
 #include <any>
 #include <algorithm>
+#include <chrono>
+#include <future>
 
 #include "eckit/runtime/Main.h"
 #include "eckit/config/YAMLConfiguration.h"
@@ -25,7 +27,10 @@
 #include "eckit/mpi/Comm.h"
 
 #include "infero/api/infero.h"
+#include "infero/infero_debug.h"
+#include "infero/models/ColumnBatch.h"
 #include "infero/models/InferenceModel.h"
+#include "infero/models/TensorLayout.h"
 
 
 using namespace eckit;
@@ -108,6 +113,114 @@ int infero_set_failure_handler(infero_failure_handler_t handler, void* context)
     });
 }
 
+/** Wraps the user arrays of a MIMO call into tensors (names and shapes are copied) */
+static void wrapTensors(int n, const char** names, const int* ranks, const int** shapes, float* const* data,
+                        int layout, std::map<std::string, TensorFloat*>& map,
+                        std::vector<std::unique_ptr<TensorFloat>>& tensors) {
+
+    ASSERT(n >= 1);
+    for (size_t i = 0; i < static_cast<size_t>(n); i++) {
+
+        // rank
+        size_t rank = static_cast<size_t>(ranks[i]);
+        ASSERT(rank >= 1);
+
+        // shape
+        std::vector<size_t> shape_(rank);
+        for (size_t rr = 0; rr < rank; rr++) {
+            shape_[rr] = static_cast<size_t>(shapes[i][rr]);
+        }
+
+        tensors.emplace_back(new TensorFloat(data[i], shape_, static_cast<TensorFloat::Layout>(layout)));
+        map.insert(make_pair(names[i], tensors.back().get()));
+    }
+}
+
+/** Float RowMajor staging of the tensors of a double precision call (2-D
+ * ColMajor tensors of a "layoutReinterpret" model keep their layout).
+ * The conversion is fused with any layout re-ordering (a single pass per
+ * tensor, each way) and the float buffers are per thread, reused across calls */
+class DoubleStaging {
+public:
+
+    /// with keepColMajor2d, 2-D ColMajor tensors are staged as they are (see "layoutReinterpret")
+    explicit DoubleStaging(bool keepColMajor2d = false) : keepColMajor2d_{keepColMajor2d} {}
+
+    TensorFloat* input(const double* data, const std::vector<size_t>& shape, TensorFloat::Layout layout) {
+        float* buffer = nextBuffer(shape, stagedLayout(shape, layout));
+        if (layout != tensors_.back()->layout()) {
+            layout::colMajorToRowMajor(data, buffer, shape);
+        } else {
+            layout::convert(data, buffer, tensors_.back()->size());
+        }
+        return tensors_.back().get();
+    }
+
+    TensorFloat* output(double* data, const std::vector<size_t>& shape, TensorFloat::Layout layout) {
+        nextBuffer(shape, stagedLayout(shape, layout));
+        outputs_.push_back({tensors_.back().get(), data, layout});
+        return tensors_.back().get();
+    }
+
+    /// copy the staged outputs back to the caller arrays
+    void writeBack() {
+        for (const auto& o : outputs_) {
+            if (o.layout != o.staged->layout()) {
+                layout::rowMajorToColMajor(o.staged->data(), o.data, o.staged->shape());
+            } else {
+                layout::convert(o.staged->data(), o.data, o.staged->size());
+            }
+        }
+    }
+
+private:
+
+    TensorFloat::Layout stagedLayout(const std::vector<size_t>& shape, TensorFloat::Layout layout) const {
+        return (keepColMajor2d_ && shape.size() == 2) ? layout : TensorFloat::Layout::RowMajor;
+    }
+
+    float* nextBuffer(const std::vector<size_t>& shape, TensorFloat::Layout layout) {
+        static thread_local std::vector<std::vector<float>> buffers;
+
+        size_t size = 1;
+        for (auto d : shape) {
+            size *= d;
+        }
+
+        if (buffers.size() <= tensors_.size()) {
+            buffers.resize(tensors_.size() + 1);
+        }
+        std::vector<float>& buffer = buffers[tensors_.size()];
+        if (buffer.size() < size) {
+            buffer.resize(size);
+        }
+
+        tensors_.emplace_back(new TensorFloat(buffer.data(), shape, layout));
+        return buffer.data();
+    }
+
+    struct Output {
+        const TensorFloat* staged;
+        double* data;
+        TensorFloat::Layout layout;
+    };
+
+    std::vector<std::unique_ptr<TensorFloat>> tensors_;  // non-owning views of the buffers
+    std::vector<Output> outputs_;
+    bool keepColMajor2d_;
+};
+
+static TensorFloat::Layout floatLayout(TensorDouble::Layout layout) {
+    return layout == TensorDouble::Layout::ColMajor ? TensorFloat::Layout::ColMajor : TensorFloat::Layout::RowMajor;
+}
+
+/** Shape of the i-th tensor of a MIMO call */
+static std::vector<size_t> tensorShape(const int* ranks, const int** shapes, size_t i) {
+    size_t rank = static_cast<size_t>(ranks[i]);
+    ASSERT(rank >= 1);
+    return std::vector<size_t>(shapes[i], shapes[i] + rank);
+}
+
 // ----------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -121,6 +234,60 @@ struct infero_handle_t {
     std::unique_ptr<InferenceModel> impl_;
 };
 
+// named tensors of a mimo call, built once and reused
+struct infero_tensor_set_t {
+
+    void push(const char* name, std::vector<size_t> shape, float* data, TensorFloat::Layout layout) {
+        ASSERT(name);
+        ASSERT(!shape.empty());
+
+        names_.emplace_back(name);
+        tensors_.emplace_back(new TensorFloat(data, shape, layout));
+        tensorPtrs_.push_back(tensors_.back().get());
+
+        // (names_ may have moved the strings)
+        namePtrs_.clear();
+        for (const auto& n : names_) {
+            namePtrs_.push_back(n.c_str());
+        }
+    }
+
+    void setData(size_t i, float* data) {
+        ASSERT(i < tensors_.size());
+
+        // a tensor wraps a fixed pointer: re-wrap only if it changes
+        TensorFloat& t = *tensors_[i];
+        if (t.data() != data) {
+            tensors_[i].reset(new TensorFloat(data, t.shape(), t.layout()));
+            tensorPtrs_[i] = tensors_[i].get();
+        }
+    }
+
+    std::vector<std::string> names_;
+    std::vector<std::unique_ptr<TensorFloat>> tensors_;
+
+    // as expected by InferenceModel::infer_mimo
+    std::vector<const char*> namePtrs_;
+    std::vector<TensorFloat*> tensorPtrs_;
+};
+
+// blocks of columns added by several threads, run as one batch
+struct infero_column_batch_t {
+    infero_column_batch_t(infero_handle_t* h, const char* input_name, const char* output_name) :
+        handle_(h), inputName_(input_name ? input_name : ""), outputName_(output_name ? output_name : "") {}
+
+    infero_handle_t* handle_;
+    std::string inputName_;
+    std::string outputName_;
+    ColumnBatch batch_;
+};
+
+// asynchronous inference request
+struct infero_request_t {
+    std::vector<std::unique_ptr<TensorFloat>> tensors_;
+    std::future<void> done_;
+};
+
 int infero_initialise(int argc, char** argv){
     return wrapApiFunction([argc, argv]{
 
@@ -174,6 +341,7 @@ int infero_close_handle(infero_handle_t* h) {
 int infero_delete_handle(infero_handle_t* h) {
     return wrapApiFunction([&h]{
         if (h){
+            h->impl_->wait_async();
             delete h;
             h = nullptr;
         }
@@ -220,11 +388,19 @@ int infero_inference_double(infero_handle_t* h,
                             const int shape2[],
                             int layout2) {
 
-    return wrapApiFunction([]{
-        std::cout << "infero_inference_double() - NOTIMP" << std::endl;
-        NOTIMP;
+    return wrapApiFunction([h, rank1, data1, shape1, layout1, rank2, data2, shape2, layout2]{
+        ASSERT(h);
+
+        DoubleStaging staging(h->impl_->layoutReinterpret());
+        TensorFloat* tIn = staging.input(data1, std::vector<size_t>(shape1, shape1 + rank1),
+                                         static_cast<TensorFloat::Layout>(layout1));
+        TensorFloat* tOut = staging.output(data2, std::vector<size_t>(shape2, shape2 + rank2),
+                                           static_cast<TensorFloat::Layout>(layout2));
+
+        h->impl_->infer(*tIn, *tOut);
+
+        staging.writeBack();
     });
-   
 }
 
 
@@ -258,58 +434,75 @@ int infero_inference_float_mimo(infero_handle_t* h,
                             oLayout]{
         ASSERT(h);
 
-        std::cout << "infero_inference_float_mimo()" << std::endl;
+        INFERO_DEBUG_LOG << "infero_inference_float_mimo()" << std::endl;
+
+        std::vector<std::unique_ptr<TensorFloat>> tensors;
 
-        // loop over INPUT tensors
-        ASSERT(nInputs >= 1);
         std::map<std::string,TensorFloat*> imap;
-        for (size_t i=0; i<static_cast<size_t>(nInputs); i++){
+        wrapTensors(nInputs, iNames, iRanks, iShape, const_cast<float**>(iData), iLayout, imap, tensors);
 
-            // rank
-            size_t rank = static_cast<size_t>(*(iRanks+i));
-            ASSERT(rank >= 1);
+        std::map<std::string,TensorFloat*> omap;
+        wrapTensors(nOutputs, oNames, oRanks, oShape, oData, oLayout, omap, tensors);
 
-            // shape
-            std::vector<size_t> shape_(rank);
-            for (size_t rr=0; rr<rank; rr++){
-                shape_[rr] = static_cast<size_t>(*(*(iShape+i)+rr));
-            }
-            imap.insert(make_pair(*(iNames+i), new TensorFloat(const_cast<float*>(*(iData+i)), shape_, static_cast<TensorFloat::Layout>(iLayout))));
-        }
+        // mimo inference
+        h->impl_->infer_mimo(imap, omap);
 
-        // loop over OUTPUT tensors
-        ASSERT(nOutputs >= 1);
-        std::map<std::string,TensorFloat*> omap;
-        for (size_t i=0; i<static_cast<size_t>(nOutputs); i++){
+    });
+}
 
-            // rank
-            size_t rank = static_cast<size_t>(*(oRanks+i));
-            ASSERT(rank >= 1);
 
-            // shape
-            std::vector<size_t> shape_(rank);
-            for (size_t rr=0; rr<rank; rr++){
-                shape_[rr] = static_cast<size_t>(*(*(oShape+i)+rr));
-            }
+// start a ML engine inference
+int infero_inference_float_mimo_async(infero_handle_t* h,
+                                      int nInputs,
+                                      const char** iNames,
+                                      const int* iRanks,
+                                      const int** iShape,
+                                      const float** iData,
+                                      int iLayout,
+                                      int nOutputs,
+                                      const char** oNames,
+                                      const int* oRanks,
+                                      const int** oShape,
+                                      float** oData,
+                                      int oLayout,
+                                      infero_request_t** req) {
+
+    return wrapApiFunction([=]{
+        ASSERT(h);
+        ASSERT(req);
 
-            omap.insert(make_pair(*(oNames+i), new TensorFloat(*(oData+i), shape_, static_cast<TensorFloat::Layout>(oLayout))));
-        }
+        INFERO_DEBUG_LOG << "infero_inference_float_mimo_async()" << std::endl;
 
-        // mimo inference
-        h->impl_->infer_mimo(imap, omap);
+        std::unique_ptr<infero_request_t> r(new infero_request_t);
+
+        std::map<std::string,TensorFloat*> imap;
+        wrapTensors(nInputs, iNames, iRanks, iShape, const_cast<float**>(iData), iLayout, imap, r->tensors_);
+
+        std::map<std::string,TensorFloat*> omap;
+        wrapTensors(nOutputs, oNames, oRanks, oShape, oData, oLayout, omap, r->tensors_);
+
+        r->done_ = h->impl_->infer_mimo_async(imap, omap);
+        *req = r.release();
+    });
+}
 
-        std::for_each(imap.begin(),imap.end(),
-                        [](auto& item){ 
-                            delete item.second;
-                            item.second=nullptr;
-                        });
 
-        std::for_each(omap.begin(),omap.end(),
-                        [](auto& item){ 
-                            delete item.second;
-                            item.second=nullptr;
-                        });
+int infero_wait(infero_request_t* req) {
+    return wrapApiFunction([req]{
+        ASSERT(req);
 
+        // released even if the inference failed
+        std::unique_ptr<infero_request_t> r(req);
+        r->done_.get();
+    });
+}
+
+
+int infero_test(infero_request_t* req, int* flag) {
+    return wrapApiFunction([req, flag]{
+        ASSERT(req);
+        ASSERT(flag);
+        *flag = (req->done_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) ? 1 : 0;
     });
 }
 
@@ -328,9 +521,30 @@ int infero_inference_double_mimo(infero_handle_t* h,
                                 const int** oShape, 
                                 double** oData,
                                 int oLayout ){
-    return wrapApiFunction([]{
-        std::cout << "infero_inference_double_mimo() - NOTIMP" << std::endl;
-        NOTIMP;
+    return wrapApiFunction([=]{
+        ASSERT(h);
+        ASSERT(nInputs >= 1);
+        ASSERT(nOutputs >= 1);
+
+        INFERO_DEBUG_LOG << "infero_inference_double_mimo()" << std::endl;
+
+        DoubleStaging staging(h->impl_->layoutReinterpret());
+
+        std::map<std::string,TensorFloat*> imap;
+        for (size_t i=0; i<static_cast<size_t>(nInputs); i++){
+            imap.insert(make_pair(iNames[i], staging.input(iData[i], tensorShape(iRanks, iShape, i),
+                                                           static_cast<TensorFloat::Layout>(iLayout))));
+        }
+
+        std::map<std::string,TensorFloat*> omap;
+        for (size_t i=0; i<static_cast<size_t>(nOutputs); i++){
+            omap.insert(make_pair(oNames[i], staging.output(oData[i], tensorShape(oRanks, oShape, i),
+                                                            static_cast<TensorFloat::Layout>(oLayout))));
+        }
+
+        h->impl_->infer_mimo(imap, omap);
+
+        staging.writeBack();
     });
 }
 
@@ -363,9 +577,133 @@ int infero_inference_float_map(infero_handle_t* h, void* imap_any_ptr, void* oma
 
 int infero_inference_double_map(infero_handle_t* h, void* imap_any_ptr, void* omap_any_ptr){
 
-    return wrapApiFunction([]{
-        std::cout << "infero_inference_double_map() - NOTIMP" << std::endl;
-        NOTIMP;
+    return wrapApiFunction([h, imap_any_ptr, omap_any_ptr]{
+
+        ASSERT(h);
+        ASSERT(imap_any_ptr);
+        ASSERT(omap_any_ptr);
+
+        DoubleStaging staging(h->impl_->layoutReinterpret());
+
+        std::map<std::string,std::any>* imap_any = static_cast<std::map<std::string,std::any>*>(imap_any_ptr);
+        std::map<std::string, TensorFloat*> imap;
+        for (const auto& item: *imap_any) {
+            TensorDouble* t = static_cast<TensorDouble*>(std::any_cast<void*>(item.second));
+            imap.insert(make_pair(item.first, staging.input(t->data(), t->shape(), floatLayout(t->layout()))));
+        }
+
+        std::map<std::string,std::any>* omap_any = static_cast<std::map<std::string,std::any>*>(omap_any_ptr);
+        std::map<std::string, TensorFloat*> omap;
+        for (const auto& item: *omap_any) {
+            TensorDouble* t = static_cast<TensorDouble*>(std::any_cast<void*>(item.second));
+            omap.insert(make_pair(item.first, staging.output(t->data(), t->shape(), floatLayout(t->layout()))));
+        }
+
+        h->impl_->infer_mimo(imap, omap);
+
+        staging.writeBack();
+    });
+}
+
+
+int infero_create_tensor_set(infero_tensor_set_t** set) {
+    return wrapApiFunction([set]{
+        ASSERT(set);
+        *set = new infero_tensor_set_t;
+    });
+}
+
+
+int infero_tensor_set_push_tensor(infero_tensor_set_t* set,
+                                  const char* name,
+                                  int rank,
+                                  const int* shape,
+                                  float* data,
+                                  int layout) {
+    return wrapApiFunction([=]{
+        ASSERT(set);
+        ASSERT(rank >= 1);
+        set->push(name, std::vector<size_t>(shape, shape + rank), data, static_cast<TensorFloat::Layout>(layout));
+    });
+}
+
+
+int infero_tensor_set_set_data(infero_tensor_set_t* set, int index, float* data) {
+    return wrapApiFunction([set, index, data]{
+        ASSERT(set);
+        ASSERT(index >= 0);
+        set->setData(static_cast<size_t>(index), data);
+    });
+}
+
+
+int infero_delete_tensor_set(infero_tensor_set_t* set) {
+    return wrapApiFunction([set]{
+        delete set;
+    });
+}
+
+
+int infero_inference_float_tensor_set(infero_handle_t* h,
+                                      infero_tensor_set_t* iset,
+                                      infero_tensor_set_t* oset) {
+    return wrapApiFunction([h, iset, oset]{
+        ASSERT(h);
+        ASSERT(iset && !iset->tensors_.empty());
+        ASSERT(oset && !oset->tensors_.empty());
+
+        h->impl_->infer_mimo(iset->tensorPtrs_, iset->namePtrs_, oset->tensorPtrs_, oset->namePtrs_);
+    });
+}
+
+
+int infero_create_column_batch(infero_handle_t* h,
+                               const char* input_name,
+                               const char* output_name,
+                               infero_column_batch_t** batch) {
+    return wrapApiFunction([=]{
+        ASSERT(h);
+        ASSERT(batch);
+        *batch = new infero_column_batch_t(h, input_name, output_name);
+    });
+}
+
+
+int infero_column_batch_add(infero_column_batch_t* batch,
+                            int rows,
+                            int ninputs,
+                            const float* input,
+                            int output_rows,
+                            int noutputs,
+                            float* output,
+                            int layout) {
+    return wrapApiFunction([=]{
+        ASSERT(batch);
+        if (output_rows != rows) {
+            throw BadValue("Column block input and output must have the same number of rows (columns), found " +
+                               std::to_string(rows) + " and " + std::to_string(output_rows),
+                           Here());
+        }
+        ASSERT(rows > 0 && ninputs > 0 && noutputs > 0);
+        batch->batch_.add(rows, ninputs, input, noutputs, output, static_cast<TensorFloat::Layout>(layout));
+    });
+}
+
+
+int infero_column_batch_run(infero_column_batch_t* batch) {
+    return wrapApiFunction([batch]{
+        ASSERT(batch);
+        InferenceModel& model = *batch->handle_->impl_;
+        batch->batch_.run([batch, &model](TensorFloat& tIn, TensorFloat& tOut) {
+            model.infer(tIn, tOut, batch->inputName_, batch->outputName_);
+        });
+    });
+}
+
+
+int infero_delete_column_batch(infero_column_batch_t* batch) {
+    return wrapApiFunction([batch]{
+        delete batch;
     });
 }
 
@@ -55,12 +55,18 @@ int infero_set_failure_handler(infero_failure_handler_t handler, void* context);
 
 // -------------------------------------------------------------
 
-// struct infero_tensor_set_t;
-// typedef struct infero_tensor_set_t infero_tensor_set_t;
+struct infero_tensor_set_t;
+typedef struct infero_tensor_set_t infero_tensor_set_t;
 
 struct infero_handle_t;
 typedef struct infero_handle_t infero_handle_t;
 
+struct infero_request_t;
+typedef struct infero_request_t infero_request_t;
+
+struct infero_column_batch_t;
+typedef struct infero_column_batch_t infero_column_batch_t;
+
 /**
  * initialize infero library
  */
@@ -134,6 +140,37 @@ int infero_inference_float_mimo(infero_handle_t* h,
                                 float** oData,
                                 int oLayout);
 
+/** start a ML engine inference (float) with multi-input and multi-output,
+ * same arguments as infero_inference_float_mimo. Returns as soon as the
+ * request is queued: the names and shapes are copied, but the data arrays
+ * must stay valid (and the outputs unread) until the request completes.
+ * Every request must be released with infero_wait.
+ */
+int infero_inference_float_mimo_async(infero_handle_t* h,
+                                      int nInputs,
+                                      const char** iNames,
+                                      const int* iRanks,
+                                      const int** iShape,
+                                      const float** iData,
+                                      int iLayout,
+                                      int nOutputs,
+                                      const char** oNames,
+                                      const int* oRanks,
+                                      const int** oShape,
+                                      float** oData,
+                                      int oLayout,
+                                      infero_request_t** req);
+
+/** waits for an asynchronous inference to complete and releases the request
+ * \returns the error code of the inference
+ */
+int infero_wait(infero_request_t* req);
+
+/** checks (without blocking) if an asynchronous inference has completed
+ * \param flag set to 1 if completed (infero_wait will then not block), 0 otherwise
+ */
+int infero_test(infero_request_t* req, int* flag);
+
 /** run a ML engine for inference (float)
 * with multi-input and multi-output
 */
@@ -161,6 +198,73 @@ int infero_inference_float_map(infero_handle_t* h, void* imap, void* omap);
  */
 int infero_inference_double_map(infero_handle_t* h, void* imap, void* omap);
 
+/**
+ * Creates an empty set of (float) tensors, to be reused across inference calls
+ */
+int infero_create_tensor_set(infero_tensor_set_t** set);
+
+/**
+ * Appends a tensor to the set (name and shape are copied, data is not)
+ */
+int infero_tensor_set_push_tensor(infero_tensor_set_t* set,
+                                  const char* name,
+                                  int rank,
+                                  const int* shape,
+                                  float* data,
+                                  int layout);
+
+/**
+ * Points the index-th tensor of the set (0-based, in push order) to new data
+ * of the same shape and layout
+ */
+int infero_tensor_set_set_data(infero_tensor_set_t* set, int index, float* data);
+
+/**
+ * Destroys the tensor set (not the data)
+ */
+int infero_delete_tensor_set(infero_tensor_set_t* set);
+
+/**
+ * Run mimo inference from tensor sets (no per-call allocation)
+ */
+int infero_inference_float_tensor_set(infero_handle_t* h,
+                                      infero_tensor_set_t* iset,
+                                      infero_tensor_set_t* oset);
+
+/**
+ * Creates an accumulator of blocks of columns (e.g. NPROMA blocks), run as
+ * one batch by the model of the handle (NULL names: the model defaults)
+ */
+int infero_create_column_batch(infero_handle_t* h,
+                               const char* input_name,
+                               const char* output_name,
+                               infero_column_batch_t** batch);
+
+/**
+ * Adds a block of columns: input [rows, ninputs] and output [output_rows, noutputs]
+ * in the given layout, with as many rows (thread-safe, the arrays must stay
+ * valid until the run)
+ */
+int infero_column_batch_add(infero_column_batch_t* batch,
+                            int rows,
+                            int ninputs,
+                            const float* input,
+                            int output_rows,
+                            int noutputs,
+                            float* output,
+                            int layout);
+
+/**
+ * Runs all the blocks added so far as one RowMajor batch and writes the
+ * outputs of each block (once all the blocks have been added)
+ */
+int infero_column_batch_run(infero_column_batch_t* batch);
+
+/**
+ * Destroys the column batch (not the handle)
+ */
+int infero_delete_column_batch(infero_column_batch_t* batch);
+
 /**
  * @brief infero_print_statistics
  * @param h: handle
@@ -24,6 +24,15 @@ int infero_set_failure_handler(infero_failure_handler_t handler, void* context);
 struct infero_handle_t;
 typedef struct infero_handle_t infero_handle_t;
 
+struct infero_request_t;
+typedef struct infero_request_t infero_request_t;
+
+struct infero_tensor_set_t;
+typedef struct infero_tensor_set_t infero_tensor_set_t;
+
+struct infero_column_batch_t;
+typedef struct infero_column_batch_t infero_column_batch_t;
+
 /**
  * initialize infero library
  */
@@ -97,6 +106,30 @@ int infero_inference_float_mimo(infero_handle_t* h,
                                 float** oData,
                                 int oLayout);
 
+/** start a ML engine inference (float)
+* with multi-input and multi-output
+*/
+int infero_inference_float_mimo_async(infero_handle_t* h,
+                                      int nInputs,
+                                      const char** iNames,
+                                      const int* iRanks,
+                                      const int** iShape,
+                                      const float** iData,
+                                      int iLayout,
+                                      int nOutputs,
+                                      const char** oNames,
+                                      const int* oRanks,
+                                      const int** oShape,
+                                      float** oData,
+                                      int oLayout,
+                                      infero_request_t** req);
+
+/** waits for an asynchronous inference and releases the request */
+int infero_wait(infero_request_t* req);
+
+/** checks if an asynchronous inference has completed */
+int infero_test(infero_request_t* req, int* flag);
+
 /** run a ML engine for inference (float)
 * with multi-input and multi-output
 */
@@ -124,6 +157,68 @@ int infero_inference_float_map(infero_handle_t* h, void* imap, void* omap);
  */
 int infero_inference_double_map(infero_handle_t* h, void* imap, void* omap);
 
+/**
+ * Creates an empty set of (float) tensors
+ */
+int infero_create_tensor_set(infero_tensor_set_t** set);
+
+/**
+ * Appends a tensor to the set
+ */
+int infero_tensor_set_push_tensor(infero_tensor_set_t* set,
+                                  const char* name,
+                                  int rank,
+                                  const int* shape,
+                                  float* data,
+                                  int layout);
+
+/**
+ * Points a tensor of the set to new data
+ */
+int infero_tensor_set_set_data(infero_tensor_set_t* set, int index, float* data);
+
+/**
+ * Destroys the tensor set
+ */
+int infero_delete_tensor_set(infero_tensor_set_t* set);
+
+/**
+ * Run mimo inference from tensor sets
+ */
+int infero_inference_float_tensor_set(infero_handle_t* h,
+                                      infero_tensor_set_t* iset,
+                                      infero_tensor_set_t* oset);
+
+/**
+ * Creates an accumulator of blocks of columns, run as one batch
+ */
+int infero_create_column_batch(infero_handle_t* h,
+                               const char* input_name,
+                               const char* output_name,
+                               infero_column_batch_t** batch);
+
+/**
+ * Adds a block of columns (input and output arrays)
+ */
+int infero_column_batch_add(infero_column_batch_t* batch,
+                            int rows,
+                            int ninputs,
+                            const float* input,
+                            int output_rows,
+                            int noutputs,
+                            float* output,
+                            int layout);
+
+/**
+ * Runs all the blocks added so far as one batch
+ */
+int infero_column_batch_run(infero_column_batch_t* batch);
+
+/**
+ * Destroys the column batch
+ */
+int infero_delete_column_batch(infero_column_batch_t* batch);
+
 /**
  * @brief infero_print_statistics
  * @param h: handle
@@ -0,0 +1,36 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+
+#include "eckit/log/Log.h"
+
+
+namespace infero {
+
+/// Verbose (per inference call) logging, enabled by setting INFERO_DEBUG
+/// in the environment (to anything but "0"). Read once per process.
+inline bool debugEnabled() {
+    static const bool enabled = [] {
+        const char* env = std::getenv("INFERO_DEBUG");
+        return env && std::strcmp(env, "0") != 0;
+    }();
+    return enabled;
+}
+
+}  // namespace infero
+
+
+/// INFERO_DEBUG_LOG << ... ; (nothing is formatted when disabled)
+#define INFERO_DEBUG_LOG \
+    if (!::infero::debugEnabled()) {} else eckit::Log::info()
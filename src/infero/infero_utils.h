@@ -50,6 +50,12 @@ std::vector<T> convert_shape(const std::vector<F>& vec) {
     return vec_new;
 }
 
+/// same, into a vector of allocator A (e.g. an ArenaAllocator)
+template <typename F, typename T, typename A>
+std::vector<T, A> convert_shape(const std::vector<F>& vec, const A& alloc) {
+    return std::vector<T, A>(vec.begin(), vec.end(), alloc);
+}
+
 
 /// Tensor from properly formatted CSV file:
 ///
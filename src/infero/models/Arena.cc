@@ -0,0 +1,89 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <cstdint>
+#include <new>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "infero/models/Arena.h"
+
+
+namespace infero {
+
+namespace {
+
+inline size_t padding(const char* p, size_t alignment) {
+    return static_cast<size_t>(-reinterpret_cast<uintptr_t>(p) & (alignment - 1));
+}
+
+}  // namespace
+
+
+Arena::Scope::Scope() : arena_{Arena::thread()} {
+    arena_.depth_++;
+}
+
+Arena::Scope::~Scope() {
+    if (--arena_.depth_ == 0) {
+        arena_.reset();
+    }
+}
+
+
+Arena::Arena(size_t capacity) :
+    block_{capacity ? new char[capacity] : nullptr}, capacity_{capacity}, used_{0}, overflowBytes_{0}, depth_{0} {}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+
+    ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    if (block_) {
+        char* p    = block_.get() + used_;
+        size_t pad = padding(p, alignment);
+        if (used_ + pad + bytes <= capacity_) {
+            used_ += pad + bytes;
+            return p + pad;
+        }
+    }
+
+    // (accounted for when the block grows)
+    size_t size = bytes + alignment;
+    overflow_.emplace_back(new char[size]);
+    overflowBytes_ += size;
+
+    char* p = overflow_.back().get();
+    return p + padding(p, alignment);
+}
+
+void Arena::reset() {
+
+    if (!overflow_.empty()) {
+        overflow_.clear();
+
+        // (keeps the current block if a larger one cannot be had)
+        size_t capacity = capacity_ + overflowBytes_;
+        char* block     = new (std::nothrow) char[capacity];
+        if (block) {
+            block_.reset(block);
+            capacity_ = capacity;
+        }
+        overflowBytes_ = 0;
+    }
+
+    used_ = 0;
+}
+
+Arena& Arena::thread() {
+    static thread_local Arena arena;
+    return arena;
+}
+
+}  // namespace infero
@@ -0,0 +1,121 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+
+namespace infero {
+
+/// Bump allocator for the temporaries of an inference call.
+///
+/// Allocations are carved out of a single block and all released at once by
+/// reset(). What does not fit in the block comes from the heap, and the block
+/// grows to the high-water mark at the next reset: once warmed up, calls of
+/// the same shapes do not allocate at all.
+///
+/// Each thread has its own arena (Arena::thread()), reset when the outermost
+/// Arena::Scope of the thread ends.
+class Arena {
+
+public:
+
+    /// the temporaries of a call (nested scopes belong to the outermost one)
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        Arena& arena() { return arena_; }
+
+    private:
+        Arena& arena_;
+    };
+
+    explicit Arena(size_t capacity = 0);
+
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    /// releases all the allocations (and grows the block if it was too small)
+    void reset();
+
+    size_t capacity() const { return capacity_; }
+
+    /// bytes taken from the block since the last reset
+    size_t used() const { return used_; }
+
+    /// the arena of the calling thread
+    static Arena& thread();
+
+private:
+
+    std::unique_ptr<char[]> block_;
+    size_t capacity_;
+    size_t used_;
+
+    // allocations that did not fit in the block
+    std::vector<std::unique_ptr<char[]>> overflow_;
+    size_t overflowBytes_;
+
+    size_t depth_;
+};
+
+
+/// STL allocator drawing from an Arena (by default, the arena of the calling
+/// thread, so only within an Arena::Scope), deallocation is a no-op
+template <typename T>
+class ArenaAllocator {
+
+public:
+
+    using value_type = T;
+
+    ArenaAllocator() : arena_{&Arena::thread()} {}
+
+    explicit ArenaAllocator(Arena& arena) : arena_{&arena} {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_{other.arena()} {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T))); }
+
+    void deallocate(T*, size_t) {}
+
+    Arena* arena() const { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena_ == other.arena();
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return arena_ != other.arena();
+    }
+
+private:
+
+    Arena* arena_;
+};
+
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+}  // namespace infero
@@ -0,0 +1,104 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <cstring>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "infero/models/ColumnBatch.h"
+#include "infero/models/TensorLayout.h"
+
+
+namespace infero {
+
+ColumnBatch::ColumnBatch() : rows_{0}, inputs_{0}, outputs_{0} {}
+
+void ColumnBatch::add(size_t rows, size_t inputs, const float* in, size_t outputs, float* out,
+                      eckit::linalg::TensorFloat::Layout layout) {
+
+    ASSERT(rows > 0 && inputs > 0 && outputs > 0);
+    ASSERT(in && out);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // all the blocks of a batch have the same features
+    if (blocks_.empty()) {
+        inputs_  = inputs;
+        outputs_ = outputs;
+    }
+    else if (inputs != inputs_ || outputs != outputs_) {
+        throw eckit::BadValue("Column blocks of a batch must have the same number of inputs and outputs", Here());
+    }
+
+    blocks_.push_back({rows, rows_, in, out, layout == eckit::linalg::TensorFloat::Layout::ColMajor});
+    rows_ += rows;
+}
+
+void ColumnBatch::run(const Run& infer) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (blocks_.empty()) {
+        return;
+    }
+
+    batchIn_.resize(rows_ * inputs_);
+    batchOut_.resize(rows_ * outputs_);
+
+    // gather (ColMajor blocks are transposed straight into their rows)
+    for (const Block& b : blocks_) {
+        float* dst = &batchIn_[b.offset * inputs_];
+        if (b.colMajor) {
+            layout::transpose2d(b.in, b.rows, dst, inputs_, inputs_, b.rows);
+        }
+        else {
+            std::memcpy(dst, b.in, b.rows * inputs_ * sizeof(float));
+        }
+    }
+
+    eckit::linalg::TensorFloat tIn(batchIn_.data(), {rows_, inputs_}, eckit::linalg::TensorFloat::Layout::RowMajor);
+    eckit::linalg::TensorFloat tOut(batchOut_.data(), {rows_, outputs_}, eckit::linalg::TensorFloat::Layout::RowMajor);
+
+    // (starts over, even if the inference fails)
+    try {
+        infer(tIn, tOut);
+    }
+    catch (...) {
+        blocks_.clear();
+        rows_ = 0;
+        throw;
+    }
+
+    // scatter
+    for (const Block& b : blocks_) {
+        const float* src = &batchOut_[b.offset * outputs_];
+        if (b.colMajor) {
+            layout::transpose2d(src, outputs_, b.out, b.rows, b.rows, outputs_);
+        }
+        else {
+            std::memcpy(b.out, src, b.rows * outputs_ * sizeof(float));
+        }
+    }
+
+    blocks_.clear();
+    rows_ = 0;
+}
+
+size_t ColumnBatch::blocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return blocks_.size();
+}
+
+size_t ColumnBatch::rows() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rows_;
+}
+
+}  // namespace infero
@@ -0,0 +1,71 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "eckit/linalg/Tensor.h"
+
+
+namespace infero {
+
+/// Accumulates blocks of columns (e.g. the NPROMA blocks of a physics time
+/// step) and runs them as a single inference.
+///
+/// Each block is a [rows, inputs] input and a [rows, outputs] output array, in
+/// either layout, added by any thread. run() gathers all the blocks into one
+/// RowMajor [sum of rows, inputs] batch, runs the engine once and scatters the
+/// output rows back to the arrays of each block, then starts over (keeping its
+/// buffers for the next time step).
+class ColumnBatch {
+
+public:
+
+    /// runs the batch ([rows, inputs] -> [rows, outputs], RowMajor)
+    using Run = std::function<void(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut)>;
+
+    ColumnBatch();
+
+    /// thread-safe, the arrays must stay valid until run()
+    void add(size_t rows, size_t inputs, const float* in, size_t outputs, float* out,
+             eckit::linalg::TensorFloat::Layout layout);
+
+    /// runs all the blocks added so far (no add while it runs)
+    void run(const Run& infer);
+
+    size_t blocks() const;
+
+    size_t rows() const;
+
+private:
+
+    struct Block {
+        size_t rows;
+        size_t offset;
+        const float* in;
+        float* out;
+        bool colMajor;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Block> blocks_;
+    size_t rows_;
+    size_t inputs_;
+    size_t outputs_;
+
+    // batched RowMajor input and output
+    std::vector<float> batchIn_;
+    std::vector<float> batchOut_;
+};
+
+}  // namespace infero
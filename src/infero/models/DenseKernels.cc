@@ -0,0 +1,219 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#include "eckit/exception/Exceptions.h"
+
+#include "infero/models/DenseKernels.h"
+
+
+namespace infero {
+namespace mlp {
+
+namespace {
+
+// columns of a kernel panel (two AVX registers)
+constexpr size_t PANEL = 16;
+
+// rows of the register tile
+constexpr size_t ROWS = 4;
+
+// inputs per cache block (a block of a panel is 16 KiB)
+constexpr size_t BLOCK = 256;
+
+
+/// tile[r][c] += sum_k x[r * ldx + k] * w[k * PANEL + c], for r < M, k < n
+template <size_t M>
+inline void kernel(const float* x, size_t ldx, const float* w, size_t n, float tile[ROWS][PANEL]) {
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+    __m256 lo[M];
+    __m256 hi[M];
+    for (size_t r = 0; r < M; r++) {
+        lo[r] = _mm256_loadu_ps(tile[r]);
+        hi[r] = _mm256_loadu_ps(tile[r] + 8);
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        __m256 w0 = _mm256_loadu_ps(w + k * PANEL);
+        __m256 w1 = _mm256_loadu_ps(w + k * PANEL + 8);
+        for (size_t r = 0; r < M; r++) {
+            __m256 xv = _mm256_broadcast_ss(x + r * ldx + k);
+            lo[r]     = _mm256_fmadd_ps(xv, w0, lo[r]);
+            hi[r]     = _mm256_fmadd_ps(xv, w1, hi[r]);
+        }
+    }
+
+    for (size_t r = 0; r < M; r++) {
+        _mm256_storeu_ps(tile[r], lo[r]);
+        _mm256_storeu_ps(tile[r] + 8, hi[r]);
+    }
+
+#else
+
+    // (fixed-width inner loop on local sums, left to the compiler to vectorise)
+    float acc[M][PANEL];
+    std::memcpy(acc, tile, sizeof(acc));
+
+    for (size_t k = 0; k < n; k++) {
+        const float* wk = w + k * PANEL;
+        for (size_t r = 0; r < M; r++) {
+            float xv = x[r * ldx + k];
+            for (size_t c = 0; c < PANEL; c++) {
+                acc[r][c] += xv * wk[c];
+            }
+        }
+    }
+
+    std::memcpy(tile, acc, sizeof(acc));
+
+#endif
+}
+
+inline void activate(float* v, size_t n, Activation act) {
+    switch (act) {
+        case Activation::Relu:
+            for (size_t i = 0; i < n; i++) {
+                v[i] = std::max(v[i], 0.f);
+            }
+            break;
+        case Activation::Tanh:
+            for (size_t i = 0; i < n; i++) {
+                v[i] = std::tanh(v[i]);
+            }
+            break;
+        case Activation::Sigmoid:
+            for (size_t i = 0; i < n; i++) {
+                v[i] = 1.f / (1.f + std::exp(-v[i]));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+}  // namespace
+
+
+Activation activation(const std::string& name) {
+    if (name == "linear" || name == "none") {
+        return Activation::Linear;
+    }
+    if (name == "relu") {
+        return Activation::Relu;
+    }
+    if (name == "tanh") {
+        return Activation::Tanh;
+    }
+    if (name == "sigmoid") {
+        return Activation::Sigmoid;
+    }
+    throw eckit::BadValue("Activation must be one of linear|relu|tanh|sigmoid, found " + name, Here());
+}
+
+bool vectorised() {
+#if defined(__AVX2__) && defined(__FMA__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+DenseLayer::DenseLayer(const float* kernel, const float* bias, size_t inputs, size_t outputs, Activation act) :
+    inputs_{inputs}, outputs_{outputs}, activation_{act} {
+
+    ASSERT(inputs > 0 && outputs > 0);
+
+    size_t panels = (outputs + PANEL - 1) / PANEL;
+
+    panels_.assign(panels * inputs * PANEL, 0.f);
+    for (size_t p = 0; p < panels; p++) {
+        size_t c0 = p * PANEL;
+        size_t nc = std::min(PANEL, outputs - c0);
+        for (size_t k = 0; k < inputs; k++) {
+            std::memcpy(&panels_[(p * inputs + k) * PANEL], kernel + k * outputs + c0, nc * sizeof(float));
+        }
+    }
+
+    bias_.assign(panels * PANEL, 0.f);
+    std::copy(bias, bias + outputs, bias_.begin());
+}
+
+void DenseLayer::apply(const float* x, size_t batch, float* y) const {
+
+    size_t panels = bias_.size() / PANEL;
+
+    for (size_t k0 = 0; k0 < inputs_; k0 += BLOCK) {
+
+        size_t nk  = std::min(BLOCK, inputs_ - k0);
+        bool first = (k0 == 0);
+        bool last  = (k0 + nk == inputs_);
+
+        // (the block of the panel stays in cache across the rows)
+        for (size_t p = 0; p < panels; p++) {
+
+            const float* w = &panels_[(p * inputs_ + k0) * PANEL];
+            size_t c0      = p * PANEL;
+            size_t nc      = std::min(PANEL, outputs_ - c0);
+
+            for (size_t r0 = 0; r0 < batch; r0 += ROWS) {
+
+                size_t nr = std::min(ROWS, batch - r0);
+
+                // starts from the bias, or from the sums of the previous blocks
+                alignas(32) float tile[ROWS][PANEL];
+                for (size_t r = 0; r < nr; r++) {
+                    if (first) {
+                        std::memcpy(tile[r], &bias_[c0], PANEL * sizeof(float));
+                    }
+                    else {
+                        std::memcpy(tile[r], y + (r0 + r) * outputs_ + c0, nc * sizeof(float));
+                        std::fill(tile[r] + nc, tile[r] + PANEL, 0.f);
+                    }
+                }
+
+                const float* xr = x + r0 * inputs_ + k0;
+                switch (nr) {
+                    case 4:
+                        kernel<4>(xr, inputs_, w, nk, tile);
+                        break;
+                    case 3:
+                        kernel<3>(xr, inputs_, w, nk, tile);
+                        break;
+                    case 2:
+                        kernel<2>(xr, inputs_, w, nk, tile);
+                        break;
+                    default:
+                        kernel<1>(xr, inputs_, w, nk, tile);
+                        break;
+                }
+
+                for (size_t r = 0; r < nr; r++) {
+                    if (last) {
+                        activate(tile[r], nc, activation_);
+                    }
+                    std::memcpy(y + (r0 + r) * outputs_ + c0, tile[r], nc * sizeof(float));
+                }
+            }
+        }
+    }
+}
+
+}  // namespace mlp
+}  // namespace infero
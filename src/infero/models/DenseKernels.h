@@ -0,0 +1,72 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace infero {
+namespace mlp {
+
+/// activation applied to the output of a dense layer
+enum class Activation
+{
+    Linear,
+    Relu,
+    Tanh,
+    Sigmoid
+};
+
+/// activation from its (Keras) name: linear|relu|tanh|sigmoid
+Activation activation(const std::string& name);
+
+/// whether the AVX2/FMA register kernel is built in (INFERO_SIMD=avx2|avx512|native)
+bool vectorised();
+
+/// Dense (fully connected) layer: y = act(x * kernel + bias)
+///
+/// The kernel is packed at construction into panels of a few columns, so that
+/// apply() runs a cache-blocked GEMM whose register kernel (AVX2/FMA when the
+/// build enables them, see vectorised()) streams contiguous weights. Bias and activation are
+/// applied to each output tile while it is still in cache.
+class DenseLayer {
+
+public:
+
+    /// kernel: inputs x outputs (RowMajor), bias: outputs
+    DenseLayer(const float* kernel, const float* bias, size_t inputs, size_t outputs, Activation act);
+
+    size_t inputs() const { return inputs_; }
+
+    size_t outputs() const { return outputs_; }
+
+    Activation activation() const { return activation_; }
+
+    /// x: batch x inputs, y: batch x outputs (both RowMajor, not aliased)
+    void apply(const float* x, size_t batch, float* y) const;
+
+private:
+
+    size_t inputs_;
+    size_t outputs_;
+    Activation activation_;
+
+    // kernel columns, by panels of PANEL columns (zero padded): [panel][input][column]
+    std::vector<float> panels_;
+
+    // bias (zero padded to whole panels)
+    std::vector<float> bias_;
+};
+
+}  // namespace mlp
+}  // namespace infero
@@ -0,0 +1,83 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include "eckit/exception/Exceptions.h"
+
+#include "infero/models/InferenceExecutor.h"
+
+
+namespace infero {
+
+InferenceExecutor::InferenceExecutor(size_t nThreads) : running_{0}, stopping_{false} {
+    ASSERT(nThreads >= 1);
+    threads_.reserve(nThreads);
+    for (size_t i = 0; i < nThreads; i++) {
+        threads_.emplace_back(&InferenceExecutor::work, this);
+    }
+}
+
+InferenceExecutor::~InferenceExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+
+    for (auto& t : threads_) {
+        t.join();
+    }
+}
+
+std::future<void> InferenceExecutor::submit(Task task) {
+
+    std::packaged_task<void()> pt(std::move(task));
+    std::future<void> result = pt.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ASSERT(!stopping_);
+        tasks_.push_back(std::move(pt));
+    }
+    ready_.notify_one();
+
+    return result;
+}
+
+void InferenceExecutor::drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return tasks_.empty() && running_ == 0; });
+}
+
+void InferenceExecutor::work() {
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+
+        ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+            return;  // stopping, and nothing left to run
+        }
+
+        std::packaged_task<void()> task(std::move(tasks_.front()));
+        tasks_.pop_front();
+        running_++;
+
+        // exceptions are stored in the future by the packaged_task
+        lock.unlock();
+        task();
+        lock.lock();
+
+        running_--;
+        if (tasks_.empty() && running_ == 0) {
+            idle_.notify_all();
+        }
+    }
+}
+
+}  // namespace infero
@@ -0,0 +1,64 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace infero {
+
+/// Fixed set of worker threads running tasks in submission order.
+///
+/// Backs the asynchronous inference calls of a model: each task is run by
+/// the first idle worker and its completion (or exception) is reported
+/// through the returned future.
+class InferenceExecutor {
+
+public:
+
+    using Task = std::function<void()>;
+
+    explicit InferenceExecutor(size_t nThreads);
+
+    /// runs the tasks still queued, then joins the workers
+    ~InferenceExecutor();
+
+    std::future<void> submit(Task task);
+
+    /// blocks until all the submitted tasks have completed
+    void drain();
+
+    size_t size() const { return threads_.size(); }
+
+private:
+
+    void work();
+
+private:
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable idle_;
+
+    std::deque<std::packaged_task<void()>> tasks_;
+    size_t running_;
+    bool stopping_;
+
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace infero
@@ -8,38 +8,140 @@
  * nor does it submit to any jurisdiction.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
 #include <vector>
 #include <string>
 
 #include "eckit/exception/Exceptions.h"
 #include "eckit/config/LocalConfiguration.h"
 #include "eckit/filesystem/LocalPathName.h"
-#include "eckit/mpi/Comm.h"
+#include "eckit/utils/StringTools.h"
 
 
+#include "infero/infero_debug.h"
 #include "infero/models/InferenceModel.h"
+#include "infero/models/TensorLayout.h"
 
 
 using namespace eckit;
 
 namespace infero {
 
+namespace {
+
+/// RAII access to one of the sessions of a model
+class SessionGuard {
+public:
+    SessionGuard(SessionPool& pool) : pool_(pool), slot_(pool.acquire()) {}
+    ~SessionGuard() { pool_.release(slot_); }
+    size_t slot() const { return slot_; }
+private:
+    SessionPool& pool_;
+    size_t slot_;
+};
+
+}  // namespace
+
+
 // Configuration and model-specific defaults
 InferenceModel::InferenceModel(const eckit::Configuration& conf, const eckit::Configuration& defaults) :
-    Configurable(conf.getSubConfiguration("model_config"), defaults),
-    modelBuffer_{size_t(0)},
+    Configurable(conf.getSubConfiguration("model_config"), InferenceModel::defaultConfig(defaults)),
+    modelBuffer_{},
     modelType_{conf.getString("type")},
     modelPath_{conf.getString("path")},
-    isOpen_{false} {
+    isOpen_{false},
+    sessions_{this},
+    sessionPool_{new SessionPool(1)},
+    isReplica_{false},
+    layoutReinterpret_{false} {
+
+    ASSERT(numSessions() >= 1);
+
+    size_t maxBatchSize = static_cast<size_t>(config().getInt("maxBatchSize"));
+    if (maxBatchSize > 1) {
+        batcher_.reset(new RequestBatcher(maxBatchSize, std::chrono::microseconds(config().getInt("maxBatchWait"))));
+    }
+
+    // "tileSize": "h,w" (or "s" for square tiles)
+    std::vector<std::string> tileSize = StringTools::split(",", config().getString("tileSize"));
+    if (tileSize.empty() || tileSize.size() > 2) {
+        throw BadValue("tileSize must be h,w or s, found " + config().getString("tileSize"), Here());
+    }
+    size_t tileH = std::stoul(tileSize.front());
+    size_t tileW = std::stoul(tileSize.back());
+    if (tileH > 0 && tileW > 0) {
+        tiler_.reset(new TiledInference(tileH, tileW, static_cast<size_t>(config().getInt("tileOverlap")),
+                                        TiledInference::blend(config().getString("tileBlend")),
+                                        static_cast<size_t>(config().getInt("tileBatch"))));
+    }
+
+    layoutReinterpret_ = config().getInt("layoutReinterpret") != 0;
 }
 
 InferenceModel::~InferenceModel() {
 
+    // (the backend destructor has already stopped the executor, see stopAsync)
+    stopAsync();
+
     if(isOpen_){
         close();
     }
 
-    print_statistics();
+    if (!isReplica_) {
+        print_statistics();
+    }
+}
+
+eckit::LocalConfiguration InferenceModel::defaultConfig(const eckit::Configuration& backendDefaults) {
+    eckit::LocalConfiguration config(backendDefaults);
+    config.set("numSessions", std::string{"1"});
+    config.set("maxBatchSize", std::string{"0"});
+    config.set("maxBatchWait", std::string{"100"});
+    config.set("asyncThreads", std::string{"0"});
+    config.set("shareModel", std::string{"1"});
+    config.set("modelBuffer", std::string{"broadcast"});
+    config.set("mmapPopulate", std::string{"0"});
+    config.set("mmapAdvice", std::string{"normal"});
+    config.set("tileSize", std::string{"0"});
+    config.set("tileOverlap", std::string{"0"});
+    config.set("tileBlend", std::string{"linear"});
+    config.set("tileBatch", std::string{"1"});
+    config.set("layoutReinterpret", std::string{"0"});
+    return config;
+}
+
+size_t InferenceModel::numSessions() const {
+    return static_cast<size_t>(config().getInt("numSessions"));
+}
+
+void InferenceModel::addSession(InferenceModel* session) {
+
+    // only called while the model is being built
+    ASSERT(session);
+    session->isReplica_ = true;
+
+    replicas_.emplace_back(session);
+    sessions_.push_back(session);
+    sessionPool_.reset(new SessionPool(sessions_.size()));
+}
+
+std::string InferenceModel::registryKey() const {
+
+    // (the keys of InferenceModel::defaultConfig only set how the model is run
+    // or how its file is read, models differing in them share the same load)
+    static const std::vector<std::string> runtimeKeys = defaultConfig(eckit::LocalConfiguration()).keys();
+
+    std::ostringstream key;
+    key << modelType_ << '\n' << modelPath_;
+    for (const auto& k : config().keys()) {
+        if (std::find(runtimeKeys.begin(), runtimeKeys.end(), k) == runtimeKeys.end()) {
+            key << '\n' << k << '=' << config().getString(k);
+        }
+    }
+    return key.str();
 }
 
 std::string InferenceModel::name() const
@@ -57,23 +159,97 @@ void InferenceModel::open()  {
     }
 }
 
+bool InferenceModel::reinterpretsLayout(const linalg::TensorFloat& t) const {
+    return layoutReinterpret_ && t.layout() == linalg::TensorFloat::Layout::ColMajor && t.shape().size() == 2;
+}
+
+linalg::TensorFloat* InferenceModel::reinterpretLayout(linalg::TensorFloat* t,
+                                                       std::vector<std::unique_ptr<linalg::TensorFloat>>& views) const {
+    if (!reinterpretsLayout(*t)) {
+        return t;
+    }
+
+    // ColMajor (features, batch) and RowMajor (batch, features) are the same array
+    const std::vector<size_t>& shape = t->shape();
+    views.emplace_back(new linalg::TensorFloat(t->data(), {shape[1], shape[0]}, linalg::TensorFloat::Layout::RowMajor));
+    return views.back().get();
+}
+
 void InferenceModel::infer(linalg::TensorFloat& tIn, linalg::TensorFloat& tOut, const std::string& input_name, const std::string& output_name)
 {
+    // "layoutReinterpret": (features, batch) ColMajor tensors run as RowMajor views, without transposes
+    if (reinterpretsLayout(tIn) || reinterpretsLayout(tOut)) {
+        std::vector<std::unique_ptr<linalg::TensorFloat>> views;
+        infer(*reinterpretLayout(&tIn, views), *reinterpretLayout(&tOut, views), input_name, output_name);
+        return;
+    }
+
+    // large NHWC fields, by batches of tiles on all the sessions (helped by the executor)
+    if (tiler_ && tIn.shape().size() == 4) {
+        tiler_->infer(tIn, tOut,
+                      [this, &input_name, &output_name](linalg::TensorFloat& in, linalg::TensorFloat& out) {
+                          SessionGuard session(*sessionPool_);
+                          sessions_[session.slot()]->infer_session(in, out, input_name, output_name);
+                      },
+                      sessions_.size(), sessions_.size() > 1 ? &executor() : nullptr);
+        return;
+    }
+
+    SessionGuard session(*sessionPool_);
+    sessions_[session.slot()]->infer_session(tIn, tOut, input_name, output_name);
+}
+
+std::future<void> InferenceModel::infer_async(linalg::TensorFloat& tIn, linalg::TensorFloat& tOut,
+                                              const std::string& input_name, const std::string& output_name)
+{
+    return executor().submit([this, &tIn, &tOut, input_name, output_name] {
+        infer(tIn, tOut, input_name, output_name);
+    });
+}
+
+std::future<void> InferenceModel::infer_mimo_async(const TensorMap& iMap, const TensorMap& oMap)
+{
+    // the maps are copied, the tensors are not
+    return executor().submit([this, iMap, oMap] { infer_mimo(iMap, oMap); });
+}
+
+void InferenceModel::wait_async()
+{
+    if (executor_) {
+        executor_->drain();
+    }
+}
+
+void InferenceModel::stopAsync()
+{
+    // the executor runs what is still queued before joining its workers
+    executor_.reset();
+}
+
+InferenceExecutor& InferenceModel::executor()
+{
+    std::call_once(executorOnce_, [this] {
+        size_t nThreads = static_cast<size_t>(config().getInt("asyncThreads"));
+        executor_.reset(new InferenceExecutor(nThreads ? nThreads : sessions_.size()));
+    });
+    return *executor_;
+}
 
-    std::lock_guard<std::mutex> lock(modelMutex_);
+void InferenceModel::infer_session(linalg::TensorFloat& tIn, linalg::TensorFloat& tOut,
+                                   const std::string& input_name, const std::string& output_name)
+{
+    // temporaries of the backend
+    Arena::Scope scope;
 
     // Input Tensor re-ordering as needed
+    // (a RowMajor input is handed to the backend as it is, without copy)
     eckit::Timing t_start(statistics_.timer());
-    eckit::linalg::TensorFloat input_tensor;
+    eckit::linalg::TensorFloat* input_tensor = &tIn;
 
     if (tIn.layout()==eckit::linalg::TensorFloat::Layout::ColMajor) {
-        Log::info() << "Input Tensor has right-layout, but left-layout is needed. "
-                    << "Transforming to left.." << std::endl;
-        input_tensor = tIn.transformColMajorToRowMajor();
-    } else {
-
-        // TODO: this still makes a copy (for now)
-        input_tensor = tIn;
+        INFERO_DEBUG_LOG << "Input Tensor has right-layout, but left-layout is needed. "
+                         << "Transforming to left.." << std::endl;
+        input_tensor = &reorderInput(0, tIn);
     }
     statistics_.iTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
 
@@ -83,17 +259,38 @@ void InferenceModel::infer(linalg::TensorFloat& tIn, linalg::TensorFloat& tOut,
     if ( !input_name.empty() || !output_name.empty()){
 
         // input/output names provided
-        infer_impl(input_tensor, tOut, input_name, output_name);
+        infer_impl(*input_tensor, tOut, input_name, output_name);
 
     } else {
 
         // use defaults
-        infer_impl(input_tensor, tOut);
+        infer_impl(*input_tensor, tOut);
     }
 
     statistics_.inferenceTiming_ += eckit::Timing{statistics_.timer()} - start_infer;
+    statistics_.inferenceCount_++;
+
+}
+
+eckit::linalg::TensorFloat& InferenceModel::reorderInput(size_t i, const eckit::linalg::TensorFloat& tIn)
+{
+    ASSERT(tIn.layout() == eckit::linalg::TensorFloat::Layout::ColMajor);
+
+    if (layoutBuffers_.size() <= i) {
+        layoutBuffers_.resize(i + 1);
+    }
 
+    // (re-)allocate only when the shape changes
+    std::unique_ptr<eckit::linalg::TensorFloat>& buffer = layoutBuffers_[i];
+    if (!buffer || buffer->shape() != tIn.shape()) {
+        buffer.reset(new eckit::linalg::TensorFloat(tIn.shape(), eckit::linalg::TensorFloat::Layout::RowMajor));
+    }
+
+    layout::colMajorToRowMajor(tIn.data(), buffer->data(), tIn.shape());
+    statistics_.iTensorBytesCopied_ += tIn.size() * sizeof(float);
+    statistics_.iTensorReorderCount_++;
 
+    return *buffer;
 }
 
 void InferenceModel::infer_impl(linalg::TensorFloat& tIn, linalg::TensorFloat& tOut, std::string input_name, std::string output_name)
@@ -105,32 +302,68 @@ void InferenceModel::infer_impl(linalg::TensorFloat& tIn, linalg::TensorFloat& t
 void InferenceModel::infer_mimo(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
                                 std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
 {
-    std::lock_guard<std::mutex> lock(modelMutex_);
+    if (std::any_of(tIn.begin(), tIn.end(), [this](linalg::TensorFloat* t) { return reinterpretsLayout(*t); }) ||
+        std::any_of(tOut.begin(), tOut.end(), [this](linalg::TensorFloat* t) { return reinterpretsLayout(*t); })) {
+        std::vector<std::unique_ptr<linalg::TensorFloat>> views;
+        std::vector<linalg::TensorFloat*> vIn;
+        std::vector<linalg::TensorFloat*> vOut;
+        for (auto* t : tIn) {
+            vIn.push_back(reinterpretLayout(t, views));
+        }
+        for (auto* t : tOut) {
+            vOut.push_back(reinterpretLayout(t, views));
+        }
+        infer_mimo(vIn, input_names, vOut, output_names);
+        return;
+    }
+
+    if (batcher_) {
+        batcher_->submit(tIn, input_names, tOut, output_names,
+                         [this](std::vector<eckit::linalg::TensorFloat*>& bIn, std::vector<const char*>& bInNames,
+                                std::vector<eckit::linalg::TensorFloat*>& bOut, std::vector<const char*>& bOutNames) {
+                             infer_mimo_pooled(bIn, bInNames, bOut, bOutNames);
+                         });
+    } else {
+        infer_mimo_pooled(tIn, input_names, tOut, output_names);
+    }
+}
+
+void InferenceModel::infer_mimo_pooled(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                                       std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
+{
+    SessionGuard session(*sessionPool_);
+    sessions_[session.slot()]->infer_mimo_session(tIn, input_names, tOut, output_names);
+}
 
-    // Take copy of the input tensors
-    std::vector<eckit::linalg::TensorFloat*> inputTensors(tIn.begin(), tIn.end());
+void InferenceModel::infer_mimo_session(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                                        std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
+{
+    // temporaries of the backend
+    Arena::Scope scope;
 
-    // For each tensor that needs re-ordering, do it into a copy
-    std::vector<std::unique_ptr<eckit::linalg::TensorFloat>> temporaryCopies;
+    // Take copy of the input tensors (into a vector kept by the session)
+    std::vector<eckit::linalg::TensorFloat*>& inputTensors = mimoInputs_;
+    inputTensors.assign(tIn.begin(), tIn.end());
 
+    // For each tensor that needs re-ordering, do it into a layout buffer
     eckit::Timing t_start(statistics_.timer());
     for (int i = 0; i < inputTensors.size(); ++i) {
         if (inputTensors[i]->layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
 
-            Log::info() << i << "-th Input Tensor has right-layout, "
-                        << "but left-layout is needed. Transforming to left.." << std::endl;
+            INFERO_DEBUG_LOG << i << "-th Input Tensor has right-layout, "
+                             << "but left-layout is needed. Transforming to left.." << std::endl;
 
-            temporaryCopies.emplace_back(new eckit::linalg::TensorFloat(inputTensors[i]->transformColMajorToRowMajor()));
-            inputTensors[i] = temporaryCopies.back().get();
+            inputTensors[i] = &reorderInput(i, *inputTensors[i]);
         }
     }
     statistics_.iTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
 
     // do the actual inference..
     eckit::Timing start_infer(statistics_.timer());
-    Log::info() << "doing inference.." << std::endl;
+    INFERO_DEBUG_LOG << "doing inference.." << std::endl;
     infer_mimo_impl(inputTensors, input_names, tOut, output_names);
     statistics_.inferenceTiming_ += eckit::Timing{statistics_.timer()} - start_infer;
+    statistics_.inferenceCount_++;
 
 }
 
@@ -162,8 +395,22 @@ void InferenceModel::infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*>& t
     NOTIMP;
 }
 
+void InferenceModel::copyOutput(const float* data, size_t size, eckit::linalg::TensorFloat& tOut)
+{
+    ASSERT(size == tOut.size());
+
+    if (tOut.layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
+        layout::rowMajorToColMajor(data, tOut.data(), tOut.shape());
+        statistics_.oTensorReorderCount_++;
+    } else {
+        ::memcpy(tOut.data(), data, size * sizeof(float));
+    }
+}
+
 void InferenceModel::close() {
 
+    wait_async();
+
     // soft check: multiple close() allowed
     if (!isOpen_){
         Log::info() << "INFO: Inference model already closed.. " << std::endl;
@@ -173,13 +420,48 @@ void InferenceModel::close() {
 }
 
 void InferenceModel::broadcast_model(const std::string path) {
-    modelBuffer_ = eckit::mpi::comm().broadcastFile(path, 0);
+
+    std::string mode = config().getString("modelBuffer");
+
+    if (mode == "broadcast") {
+        modelBuffer_ = ModelBuffer::broadcast(path);
+    } else if (mode == "shm") {
+        modelBuffer_ = ModelBuffer::nodeShared(path);
+    } else if (mode == "mmap") {
+        modelBuffer_ = ModelBuffer::mapped(path, config().getInt("mmapPopulate") != 0, mmapAdvice());
+    } else {
+        throw BadValue("modelBuffer must be one of broadcast|shm|mmap, found " + mode, Here());
+    }
+}
+
+ModelBuffer::Advice InferenceModel::mmapAdvice() const {
+
+    std::string advice = config().getString("mmapAdvice");
+
+    if (advice == "normal") {
+        return ModelBuffer::Advice::Normal;
+    }
+    if (advice == "sequential") {
+        return ModelBuffer::Advice::Sequential;
+    }
+    if (advice == "random") {
+        return ModelBuffer::Advice::Random;
+    }
+    if (advice == "willneed") {
+        return ModelBuffer::Advice::WillNeed;
+    }
+    throw BadValue("mmapAdvice must be one of normal|sequential|random|willneed, found " + advice, Here());
 }
 
 
 void InferenceModel::print_statistics()
 {
-    Log::info() << statistics() << std::endl;
+    // accumulated over all the sessions
+    ModelStatistics stats;
+    for (auto* session: sessions_) {
+        stats += session->statistics();
+    }
+    Log::info() << stats << std::endl;
 }
 
 
@@ -14,24 +14,70 @@
 #include <ostream>
 #include <string>
 #include <fstream>
+#include <future>
 #include <mutex>
 #include <map>
+#include <vector>
 
 #include "eckit/config/Configuration.h"
 #include "eckit/config/LocalConfiguration.h"
 #include "eckit/linalg/Tensor.h"
 #include "eckit/log/Log.h"
-#include "eckit/io/SharedBuffer.h"
 
 #include "infero/Configurable.h"
+#include "infero/models/Arena.h"
+#include "infero/models/InferenceExecutor.h"
+#include "infero/models/ModelBuffer.h"
+#include "infero/models/ModelRegistry.h"
 #include "infero/models/ModelStatistics.h"
+#include "infero/models/RequestBatcher.h"
+#include "infero/models/TiledInference.h"
+#include "infero/models/SessionPool.h"
 
 
 using eckit::Log;
 
 namespace infero {
 
+template <typename T>
+class InferenceModelBuilder;
+
 /// Interface for an inference model
+///
+/// A model owns "numSessions" (model_config) independent backend sessions.
+/// Concurrent calls to infer/infer_mimo on the same model are dispatched to a
+/// free session, and only serialise once all the sessions are busy.
+///
+/// With "maxBatchSize" > 1 (model_config), concurrent infer_mimo calls are also
+/// coalesced along dimension 0 into batches of up to maxBatchSize rows, waiting
+/// at most "maxBatchWait" microseconds for a batch to fill up.
+///
+/// The *_async calls run on an executor owned by the model (started on first
+/// use, with "asyncThreads" workers, or one per session if 0). The tensors
+/// passed to them must stay alive until the returned future is ready.
+///
+/// Models of the same type, path and backend configuration share their loaded
+/// weights/graph (see ModelRegistry), unless "shareModel" is 0. The keys set
+/// here (numSessions, modelBuffer, tileSize, ...) do not prevent sharing.
+///
+/// "modelBuffer" selects how broadcast_model reads the model file:
+/// "broadcast" (a copy per MPI rank), "shm" (a copy per node, in shared memory)
+/// or "mmap" (mapped by each process, with "mmapPopulate" and "mmapAdvice":
+/// normal|sequential|random|willneed).
+///
+/// With "tileSize" (h,w) set, infer splits 4-D NHWC inputs into tiles of that
+/// size overlapping by "tileOverlap" pixels, runs them by "tileBatch" on all
+/// the sessions (from the calling thread and the async executor) and stitches
+/// the outputs ("tileBlend": average|linear|crop), see TiledInference.
+///
+/// With "layoutReinterpret" 1, 2-D ColMajor tensors are (features, batch)
+/// arrays (e.g. Fortran a(nfeat, nbatch)): they are handed to the engine as
+/// the RowMajor (batch, features) tensors of the same memory, without either
+/// transpose. The model must then be batch-first on these tensors.
+///
+/// Backends take the temporaries of a call from the arena of the calling
+/// thread (ArenaVector), released when the call returns: once warmed up,
+/// calls of the same shapes do not allocate in infero (engines aside).
 class InferenceModel : public Configurable {
 
     using TensorMap = std::map<std::string, eckit::linalg::TensorFloat*>;
@@ -54,7 +100,21 @@ public:
     /// MIMO (Multi Input Multi Output) inference 
     virtual void infer_mimo(const TensorMap& iMap, const TensorMap& oMap);
 
-    /// closes the engine
+    /// MIMO inference on tensors and names kept by the caller (no map to build per call)
+    virtual void infer_mimo(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                            std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names);
+
+    /// run the inference in the background (errors are rethrown by future::get)
+    std::future<void> infer_async(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut,
+                                  const std::string& input_name = "", const std::string& output_name = "");
+
+    /// MIMO inference in the background (errors are rethrown by future::get)
+    std::future<void> infer_mimo_async(const TensorMap& iMap, const TensorMap& oMap);
+
+    /// blocks until all the asynchronous requests have completed
+    void wait_async();
+
+    /// closes the engine (after the pending asynchronous requests)
     virtual void close();    
 
     void print_statistics();
@@ -63,10 +123,16 @@ public:
 
     ModelStatistics& statistics(){ return statistics_; }
 
+    /// whether 2-D ColMajor tensors are handed to the engine as RowMajor views of reversed shape
+    bool layoutReinterpret() const { return layoutReinterpret_; }
+
+    /// number of backend sessions requested in the model configuration
+    size_t numSessions() const;
+
 protected: // methods
 
-    virtual void infer_mimo(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
-                        std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names);
+    /// model-independent configuration defaults, merged with the backend ones
+    static eckit::LocalConfiguration defaultConfig(const eckit::Configuration& backendDefaults);
 
     virtual void infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut,
                             std::string input_name = "", std::string output_name = "");
@@ -74,6 +140,11 @@ protected: // methods
     virtual void infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
                                  std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names);
 
+    /// runs the queued asynchronous requests and joins the executor: to be
+    /// called first thing by the backend destructors, while the requests can
+    /// still reach infer_impl
+    void stopAsync();
+
     /// print the model
     virtual void print(std::ostream& os) const = 0;
 
@@ -82,16 +153,66 @@ protected: // methods
         return os;
     }
 
+    /// read the model into modelBuffer_ (as selected by "modelBuffer")
     virtual void broadcast_model(const std::string path);
 
+    /// write the RowMajor output of the engine (size elements) into tOut,
+    /// re-ordering on the fly if tOut is ColMajor
+    void copyOutput(const float* data, size_t size, eckit::linalg::TensorFloat& tOut);
+
     const std::string& modelPath() const { return modelPath_; }
 
+    /// the loaded model shared with the models of the same type, path and
+    /// configuration (load() is only called if there is none alive)
+    template <typename T>
+    std::shared_ptr<T> sharedModel(const std::function<std::shared_ptr<T>()>& load) {
+        if (!config().getInt("shareModel")) {
+            return load();
+        }
+        return ModelRegistry::instance().get<T>(registryKey(), load);
+    }
+
     const std::string& modelType() const { return modelType_; }
 
+private: // methods
+
+    template <typename T>
+    friend class InferenceModelBuilder;
+
+    /// take ownership of an additional backend session
+    void addSession(InferenceModel* session);
+
+    void infer_session(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut,
+                       const std::string& input_name, const std::string& output_name);
+
+    void infer_mimo_session(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                            std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names);
+
+    /// MIMO inference on the first free session
+    void infer_mimo_pooled(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                           std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names);
+
+    InferenceExecutor& executor();
+
+    /// type, path and backend configuration of the model (see sharedModel)
+    std::string registryKey() const;
+
+    ModelBuffer::Advice mmapAdvice() const;
+
+    /// whether t is handed to the engine as a RowMajor view of reversed shape
+    bool reinterpretsLayout(const eckit::linalg::TensorFloat& t) const;
+
+    /// t, or its RowMajor view (kept in views) if reinterpretsLayout(t)
+    eckit::linalg::TensorFloat* reinterpretLayout(eckit::linalg::TensorFloat* t,
+                                                  std::vector<std::unique_ptr<eckit::linalg::TensorFloat>>& views) const;
+
+    /// RowMajor copy of a ColMajor input tensor, into the i-th layout buffer of this session
+    eckit::linalg::TensorFloat& reorderInput(size_t i, const eckit::linalg::TensorFloat& tIn);
+
 protected: // members
 
     // Model buffer
-    eckit::SharedBuffer modelBuffer_;
+    ModelBuffer modelBuffer_;
 
     // Stats
     ModelStatistics statistics_;
@@ -105,7 +226,38 @@ protected:
     std::string modelPath_;
 
     bool isOpen_;
-    mutable std::mutex modelMutex_;
+
+private:
+
+    // extra sessions (session 0 is this model itself)
+    std::vector<std::unique_ptr<InferenceModel>> replicas_;
+
+    // all sessions, indexed by pool slot
+    std::vector<InferenceModel*> sessions_;
+
+    std::unique_ptr<SessionPool> sessionPool_;
+
+    // optional batching of concurrent MIMO requests
+    std::unique_ptr<RequestBatcher> batcher_;
+
+    // optional tiling of large (NHWC) inputs of infer
+    std::unique_ptr<TiledInference> tiler_;
+
+    // runs the asynchronous requests (created on first use)
+    std::once_flag executorOnce_;
+    std::unique_ptr<InferenceExecutor> executor_;
+
+    // replicas do not report their own statistics
+    bool isReplica_;
+
+    // 2-D ColMajor tensors passed as RowMajor views of reversed shape
+    bool layoutReinterpret_;
+
+    // RowMajor scratch tensors for the inputs that need re-ordering (reused across calls)
+    std::vector<std::unique_ptr<eckit::linalg::TensorFloat>> layoutBuffers_;
+
+    // inputs handed to infer_mimo_impl (reused across calls)
+    std::vector<eckit::linalg::TensorFloat*> mimoInputs_;
 
 };
 
@@ -166,7 +318,11 @@ public: // methods
     ~InferenceModelBuilder() override {}
 
     InferenceModel* make(const eckit::Configuration& config) const override {
-        return new T(config);
+        std::unique_ptr<T> model(new T(config));
+        for (size_t i = 1; i < model->numSessions(); i++) {
+            model->addSession(new T(config));
+        }
+        return model.release();
     }
 };
 
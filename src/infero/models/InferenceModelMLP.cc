@@ -0,0 +1,208 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <iostream>
+
+#include "cnpy/cnpy.h"
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/log/Log.h"
+#include "eckit/utils/StringTools.h"
+
+#include "infero/models/InferenceModelMLP.h"
+#include "infero/models/TensorLayout.h"
+
+
+using namespace eckit;
+
+namespace infero {
+
+static InferenceModelBuilder<InferenceModelMLP> mlpBuilder;
+
+namespace {
+
+/// float RowMajor copy of a 1-d or 2-d numpy array
+std::vector<float> rowMajorFloats(const cnpy::NpyArray& arr, const std::string& name) {
+
+    std::vector<float> values(arr.num_vals);
+
+    if (arr.word_size == sizeof(float)) {
+        if (arr.fortran_order && arr.shape.size() == 2) {
+            layout::colMajorToRowMajor(arr.data<float>(), values.data(), arr.shape);
+        }
+        else {
+            layout::convert(arr.data<float>(), values.data(), arr.num_vals);
+        }
+    }
+    else if (arr.word_size == sizeof(double)) {
+        if (arr.fortran_order && arr.shape.size() == 2) {
+            layout::colMajorToRowMajor(arr.data<double>(), values.data(), arr.shape);
+        }
+        else {
+            layout::convert(arr.data<double>(), values.data(), arr.num_vals);
+        }
+    }
+    else {
+        throw BadValue("MLP array " + name + " must be float32 or float64", Here());
+    }
+
+    return values;
+}
+
+}  // namespace
+
+
+eckit::LocalConfiguration InferenceModelMLP::defaultConfig() {
+    eckit::LocalConfiguration config;
+    config.set("activations", std::string{"relu"});
+    return config;
+}
+
+
+InferenceModelMLP::InferenceModelMLP(const eckit::Configuration& conf) :
+    InferenceModel(conf, InferenceModelMLP::defaultConfig()) {
+
+    // the (read-only) layers are shared with the models of the same path and configuration
+    layers_ = sharedModel<Layers>([this] { return load(); });
+}
+
+InferenceModelMLP::~InferenceModelMLP() {
+    stopAsync();
+}
+
+std::shared_ptr<InferenceModelMLP::Layers> InferenceModelMLP::load() {
+
+    // (small files, read by each rank)
+    cnpy::npz_t arrays = cnpy::npz_load(modelPath());
+
+    size_t n = 0;
+    while (arrays.count("kernel_" + std::to_string(n))) {
+        n++;
+    }
+    if (n == 0) {
+        throw BadValue("No kernel_0 array in MLP model " + modelPath(), Here());
+    }
+
+    std::vector<mlp::Activation> acts = activations(n);
+
+    std::shared_ptr<Layers> layers = std::make_shared<Layers>();
+    layers->reserve(n);
+
+    for (size_t i = 0; i < n; i++) {
+
+        std::string kname = "kernel_" + std::to_string(i);
+        std::string bname = "bias_" + std::to_string(i);
+        if (!arrays.count(bname)) {
+            throw BadValue("No " + bname + " array in MLP model " + modelPath(), Here());
+        }
+
+        const cnpy::NpyArray& kernel = arrays[kname];
+        const cnpy::NpyArray& bias   = arrays[bname];
+        if (kernel.shape.size() != 2 || bias.num_vals != kernel.shape[1]) {
+            throw BadValue("MLP layer " + std::to_string(i) + ": kernel must be inputs x outputs, bias outputs",
+                           Here());
+        }
+        if (i > 0 && kernel.shape[0] != layers->back().outputs()) {
+            throw BadValue("MLP layer " + std::to_string(i) + " inputs do not match the previous outputs", Here());
+        }
+
+        std::vector<float> k = rowMajorFloats(kernel, kname);
+        std::vector<float> b = rowMajorFloats(bias, bname);
+        layers->emplace_back(k.data(), b.data(), kernel.shape[0], kernel.shape[1], acts[i]);
+    }
+
+    Log::info() << "MLP model " << modelPath() << ": " << n << " dense layers, " << layers->front().inputs()
+                << " inputs, " << layers->back().outputs() << " outputs" << std::endl;
+
+    return layers;
+}
+
+std::vector<mlp::Activation> InferenceModelMLP::activations(size_t n) const {
+
+    std::vector<std::string> names = StringTools::split(",", config().getString("activations"));
+
+    // (a single name is the one of the hidden layers, even for a single layer: that one is linear)
+    std::vector<mlp::Activation> acts;
+    if (names.size() == 1) {
+        acts.assign(n, mlp::activation(StringTools::trim(names[0])));
+        acts.back() = mlp::Activation::Linear;
+    }
+    else if (names.size() == n) {
+        for (const auto& name : names) {
+            acts.push_back(mlp::activation(StringTools::trim(name)));
+        }
+    }
+    else {
+        throw BadValue("MLP activations: one per layer (" + std::to_string(n) + ") or one for the hidden layers",
+                       Here());
+    }
+    return acts;
+}
+
+std::string InferenceModelMLP::name() const {
+    return std::string(this->type());
+}
+
+void InferenceModelMLP::infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut,
+                                   std::string input_name, std::string output_name) {
+
+    const Layers& layers = *layers_;
+
+    size_t inputs  = layers.front().inputs();
+    size_t outputs = layers.back().outputs();
+
+    ASSERT(tIn.size() % inputs == 0);
+    size_t batch = tIn.size() / inputs;
+    if (tOut.size() != batch * outputs) {
+        throw BadValue("MLP output tensor must have " + std::to_string(batch * outputs) + " elements", Here());
+    }
+
+    // hidden layers ping-pong between the scratch buffers,
+    // the last one writes straight into a RowMajor output
+    bool colMajor = (tOut.layout() == eckit::linalg::TensorFloat::Layout::ColMajor);
+
+    const float* x = tIn.data();
+    for (size_t i = 0; i < layers.size(); i++) {
+
+        float* y = nullptr;
+        if (i + 1 == layers.size() && !colMajor) {
+            y = tOut.data();
+        }
+        else {
+            std::vector<float>& buffer = scratch_[i % 2];
+            buffer.resize(batch * layers[i].outputs());
+            y = buffer.data();
+        }
+
+        layers[i].apply(x, batch, y);
+        x = y;
+    }
+
+    if (colMajor) {
+        eckit::Timing t_start(statistics_.timer());
+        copyOutput(x, batch * outputs, tOut);
+        statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
+    }
+}
+
+void InferenceModelMLP::infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                                        std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
+{
+    // (single input and output, names are not used)
+    ASSERT(tIn.size() == 1 && tOut.size() == 1);
+    infer_impl(*tIn[0], *tOut[0]);
+}
+
+void InferenceModelMLP::print(std::ostream &os) const
+{
+    os << "A native MLP Model (" << layers_->size() << " dense layers)" << std::endl;
+}
+
+}  // namespace infero
@@ -0,0 +1,75 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "infero/models/DenseKernels.h"
+#include "infero/models/InferenceModel.h"
+
+
+namespace infero {
+
+/// Built-in engine for small dense networks (multi-layer perceptrons),
+/// without the session overhead of the ML runtimes.
+///
+/// The model is a numpy .npz archive with the arrays kernel_0, bias_0,
+/// kernel_1, bias_1, ... (Keras Dense weights: kernel inputs x outputs),
+/// see scripts/convert_keras2npz.py. "activations" lists the activation of
+/// each layer (e.g. "relu,relu,linear"), or gives the one of all the hidden
+/// layers, the last one being then linear (so a single layer model is linear).
+///
+/// One input and one output, of shape [batch, inputs] / [batch, outputs]
+/// (or any shape of the same size).
+class InferenceModelMLP : public InferenceModel {
+
+public:
+
+    InferenceModelMLP(const eckit::Configuration& conf);
+
+    ~InferenceModelMLP() override;
+
+    virtual std::string name() const override;
+
+    constexpr static const char* type() { return "native_mlp"; }
+
+    void print(std::ostream& os) const override;
+
+private:
+
+    void infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut,
+                    std::string input_name = "", std::string output_name = "") override;
+
+    void infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                         std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names) override;
+
+    static eckit::LocalConfiguration defaultConfig();
+
+    using Layers = std::vector<mlp::DenseLayer>;
+
+    /// read the layers from the model path
+    std::shared_ptr<Layers> load();
+
+    /// activation of each of n layers, from "activations"
+    std::vector<mlp::Activation> activations(size_t n) const;
+
+private:
+
+    // (possibly shared, see sharedModel)
+    std::shared_ptr<const Layers> layers_;
+
+    // outputs of the hidden layers, and of the last one for ColMajor tensors (reused across calls)
+    std::vector<float> scratch_[2];
+};
+
+}  // namespace infero
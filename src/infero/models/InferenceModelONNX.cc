@@ -13,6 +13,7 @@
 #include <chrono>
 #include <iostream>
 
+#include "eckit/config/Resource.h"
 #include "eckit/exception/Exceptions.h"
 #include "eckit/log/Log.h"
 
@@ -28,6 +29,59 @@ namespace infero {
 static InferenceModelBuilder<InferenceModelONNX> onnxBuilder;
 
 
+namespace {
+
+/// sessions run on the global thread pools of the environment,
+/// rather than on pools of their own (set at initialisation, see ortEnv)
+bool globalThreadPools() {
+    static bool global = eckit::Resource<bool>(
+        "inferoOnnxGlobalThreadPools;$INFERO_ONNX_GLOBAL_THREAD_POOLS;-onnx-global-thread-pools", false);
+    return global;
+}
+
+/// the ORT environment of the process, shared by all the sessions
+///
+/// With global thread pools, their size (0: one thread per core) and the
+/// intra-op thread affinity (ORT syntax, e.g. "1,2;3,4") are also read
+/// from the command line passed to infero_initialise or the environment.
+Ort::Env& ortEnv() {
+
+    // (never deleted: sessions may still be released at exit)
+    static Ort::Env* env = [] {
+        if (!globalThreadPools()) {
+            return new Ort::Env(ORT_LOGGING_LEVEL_WARNING, "infero");
+        }
+
+        int intraOp = eckit::Resource<int>(
+            "inferoOnnxIntraOpThreads;$INFERO_ONNX_INTRA_OP_THREADS;-onnx-intra-op-threads", 0);
+        int interOp = eckit::Resource<int>(
+            "inferoOnnxInterOpThreads;$INFERO_ONNX_INTER_OP_THREADS;-onnx-inter-op-threads", 1);
+        std::string affinity = eckit::Resource<std::string>(
+            "inferoOnnxThreadAffinity;$INFERO_ONNX_THREAD_AFFINITY;-onnx-thread-affinity", "");
+
+        Ort::ThreadingOptions options;
+        options.SetGlobalIntraOpNumThreads(intraOp);
+        options.SetGlobalInterOpNumThreads(interOp);
+        if (!affinity.empty()) {
+#if ORT_API_VERSION >= 14
+            options.SetGlobalIntraOpThreadAffinity(affinity.c_str());
+#else
+            Log::warning() << "ONNX thread affinity needs ONNX Runtime 1.14, ignored" << std::endl;
+#endif
+        }
+
+        Log::info() << "ONNX global thread pools: intra-op " << intraOp << ", inter-op " << interOp
+                    << (affinity.empty() ? "" : ", affinity " + affinity) << std::endl;
+
+        return new Ort::Env(options, ORT_LOGGING_LEVEL_WARNING, "infero");
+    }();
+
+    return *env;
+}
+
+}  // namespace
+
+
 eckit::LocalConfiguration InferenceModelONNX::defaultConfig() {
     eckit::LocalConfiguration config;
     config.set("numInteropThreads", std::string{"1"});
@@ -39,37 +93,56 @@ eckit::LocalConfiguration InferenceModelONNX::defaultConfig() {
 InferenceModelONNX::InferenceModelONNX(const eckit::Configuration& conf) :
     InferenceModel(conf, InferenceModelONNX::defaultConfig()) {
 
+    // the ORT session is shared with the models of the same path and configuration (Run is thread-safe)
+    session = sharedModel<Ort::Session>([this] { return load(); });
+
+    // setup input/output interface
+    setupInputLayers();
+    setupOutputLayers();
+}
+
+std::shared_ptr<Ort::Session> InferenceModelONNX::load() {
+
+    // options must outlive the session
+    struct Loaded {
+        Ort::SessionOptions options;
+        std::unique_ptr<Ort::Session> session;
+    };
+    std::shared_ptr<Loaded> loaded(new Loaded);
+
     // read/bcast model by mpi (when possible)
     broadcast_model(modelPath());
 
-    env = std::unique_ptr<Ort::Env>(new Ort::Env(ORT_LOGGING_LEVEL_WARNING, "onnx_model"));
-
-    // Session options
-    session_options = std::unique_ptr<Ort::SessionOptions>(new Ort::SessionOptions);
-    session_options->SetInterOpNumThreads(config().getInt("numInteropThreads"));
-    session_options->SetIntraOpNumThreads(config().getInt("numIntraopThreads"));
-    session_options->SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+    // Session options (threads of the session, unless running on the global pools)
+    if (globalThreadPools()) {
+        loaded->options.DisablePerSessionThreads();
+    } else {
+        loaded->options.SetInterOpNumThreads(config().getInt("numInteropThreads"));
+        loaded->options.SetIntraOpNumThreads(config().getInt("numIntraopThreads"));
+    }
+    loaded->options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
 
     // if not null, use the model buffer
     if (modelBuffer_.size()){
         Log::info() << "Constructing ONNX model from buffer.." << std::endl;
         Log::info() << "Model expected size: " + std::to_string(modelBuffer_.size()) << std::endl;
-        session = std::unique_ptr<Ort::Session>(new Ort::Session(*env,
-                                                                 modelBuffer_.data(),
-                                                                 modelBuffer_.size(),
-                                                                 *session_options));
+        loaded->session = std::unique_ptr<Ort::Session>(new Ort::Session(ortEnv(),
+                                                                         modelBuffer_.data(),
+                                                                         modelBuffer_.size(),
+                                                                         loaded->options));
     } else {  // otherwise construct from model path
-        session = std::unique_ptr<Ort::Session>(new Ort::Session(*env, modelPath().c_str(), *session_options));
+        loaded->session = std::unique_ptr<Ort::Session>(new Ort::Session(ortEnv(), modelPath().c_str(), loaded->options));
     }
 
-
-    // setup input/output interface
-    setupInputLayers();
-    setupOutputLayers();
+    // (the session keeps the rest alive)
+    return std::shared_ptr<Ort::Session>(loaded, loaded->session.get());
 }
 
 InferenceModelONNX::~InferenceModelONNX() {
 
+    // (the queued requests use the names)
+    stopAsync();
+
     for (auto& n: inputNames){
         free (n);
     }
@@ -89,11 +162,17 @@ void InferenceModelONNX::infer_impl(TensorFloat& tIn, TensorFloat& tOut,
 
     auto memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
 
-    // only one input/output usable here
-    ASSERT(inputNames.size() == 1);
-    ASSERT(outputNames.size() == 1);
+    // only one input usable here, and one output (unless selected by name)
+    ASSERT(numInputs == 1);
+    size_t in_slot  = input_name.empty() ? 0 : inputSlot(input_name.c_str());
+    size_t out_slot = 0;
+    if (output_name.empty()) {
+        ASSERT(numOutputs == 1);
+    } else {
+        out_slot = outputSlot(output_name.c_str());
+    }
 
-    auto shape_64 = utils::convert_shape<size_t, int64_t>(tIn.shape());
+    auto shape_64 = utils::convert_shape<size_t, int64_t>(tIn.shape(), ArenaAllocator<int64_t>());
     Ort::Value input_tensor = Ort::Value::CreateTensor<float>(memory_info,
                                             tIn.data(),
                                             tIn.size(),
@@ -101,95 +180,164 @@ void InferenceModelONNX::infer_impl(TensorFloat& tIn, TensorFloat& tOut,
                                             shape_64.size());
     ASSERT(input_tensor.IsTensor());
 
+    // a RowMajor output is computed straight into tOut (no output values to allocate)
+    if (tOut.layout() == eckit::linalg::TensorFloat::Layout::RowMajor) {
+        auto out_shape_64 = utils::convert_shape<size_t, int64_t>(tOut.shape(), ArenaAllocator<int64_t>());
+        Ort::Value output_tensor = Ort::Value::CreateTensor<float>(memory_info,
+                                                tOut.data(),
+                                                tOut.size(),
+                                                out_shape_64.data(),
+                                                out_shape_64.size());
+        ASSERT(output_tensor.IsTensor());
+
+        session->Run(Ort::RunOptions{nullptr},
+                     &inputNames[in_slot],
+                     &input_tensor,
+                     1,
+                     &outputNames[out_slot],
+                     &output_tensor,
+                     1);
+        return;
+    }
+
+    // only the requested output is computed
     auto output_tensors = session->Run(Ort::RunOptions{nullptr},
-                                       inputNames.data(),
+                                       &inputNames[in_slot],
                                        &input_tensor,
-                                       numInputs,
-                                       outputNames.data(),
-                                       numOutputs);
+                                       1,
+                                       &outputNames[out_slot],
+                                       1);
 
     // output tensors
     ASSERT(output_tensors.size() == 1 && output_tensors.front().IsTensor());
 
     eckit::Timing t_start(statistics_.timer());
-    if (tOut.layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
+    // ONNX uses Left (C) tensor layouts, re-ordered (if needed) straight into tOut
+    copyOutput(output_tensors.front().GetTensorData<float>(),
+               output_tensors.front().GetTensorTypeAndShapeInfo().GetElementCount(), tOut);
+    statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
 
-         // ONNX uses Left (C) tensor layouts, so we need to convert
-         auto out_shape = output_tensors.front().GetTensorTypeAndShapeInfo().GetShape();
-         TensorFloat tLeft(const_cast<float*>(output_tensors.front().GetTensorData<float>()),
-                           utils::convert_shape<int64_t, size_t>(out_shape), 
-                           eckit::linalg::TensorFloat::Layout::RowMajor);
+}
 
-         TensorFloat tRight = tLeft.transformRowMajorToColMajor();
-         tOut = tRight;
-    }
+void InferenceModelONNX::infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                                         std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
+{
+    // all the inputs are needed, outputs can be a subset
+    ASSERT(tIn.size() == numInputs && input_names.size() == tIn.size());
+    ASSERT(tOut.size() <= numOutputs && output_names.size() == tOut.size());
+
+    // RowMajor outputs are computed straight into tOut
+    bindTensors(tIn, input_names, tOut, output_names);
+    session->Run(Ort::RunOptions{nullptr}, *binding_);
 
-    else {
-         // ONNX uses Left (C) tensor layouts, so we can copy straight into memory of tOut
-         memcpy(tOut.data(), output_tensors.front().GetTensorData<float>(),
-                output_tensors.front().GetTensorTypeAndShapeInfo().GetElementCount() * sizeof(float));
+    // ColMajor outputs are re-ordered from their scratch buffers
+    eckit::Timing t_start(statistics_.timer());
+    for (size_t i=0; i<tOut.size(); i++){
+        if (tOut[i]->layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
+            copyOutput(outputScratch_[i].data(), outputScratch_[i].size(), *tOut[i]);
+        }
     }
     statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
 
 }
 
-void InferenceModelONNX::infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
-                                         std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
-{
 
-    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-    std::vector<Ort::Value> inputTensors;
+size_t InferenceModelONNX::inputSlot(const char* name) const {
+    auto it = inputIndex.find(name);
+    if (it == inputIndex.end()) {
+        throw eckit::BadValue(std::string("ONNX model has no input named ") + name, Here());
+    }
+    return it->second;
+}
+
+
+size_t InferenceModelONNX::outputSlot(const char* name) const {
+    auto it = outputIndex.find(name);
+    if (it == outputIndex.end()) {
+        throw eckit::BadValue(std::string("ONNX model has no output named ") + name, Here());
+    }
+    return it->second;
+}
 
-    // N Input tensors
-    size_t NInputs = input_names.size();
-    for (size_t i=0; i<NInputs; i++){
 
-        auto shape_64 = utils::convert_shape<size_t, int64_t>(tIn[i]->shape());
-        Ort::Value input_tensor = Ort::Value::CreateTensor<float>(memory_info,
-                                                tIn[i]->data(),
-                                                tIn[i]->size(),
-                                                shape_64.data(),
-                                                shape_64.size());
-        ASSERT(input_tensor.IsTensor());
+void InferenceModelONNX::bindTensors(std::vector<eckit::linalg::TensorFloat*>& tIn, std::vector<const char*>& input_names,
+                                     std::vector<eckit::linalg::TensorFloat*>& tOut, std::vector<const char*>& output_names) {
 
-        inputTensors.emplace_back(std::move(input_tensor));
+    // (compared in place, nothing is copied unless the binding changes)
+    if (binding_ && boundInputs_.size() == tIn.size() && boundOutputs_.size() == tOut.size()) {
+        bool unchanged = true;
+        for (size_t i=0; i<tIn.size() && unchanged; i++){
+            unchanged = boundInputs_[i].matches(inputSlot(input_names[i]), *tIn[i]);
+        }
+        for (size_t i=0; i<tOut.size() && unchanged; i++){
+            unchanged = boundOutputs_[i].matches(outputSlot(output_names[i]), *tOut[i]);
+        }
+        if (unchanged) {
+            return;
+        }
+    }
 
+    std::vector<BoundTensor> inputs;
+    for (size_t i=0; i<tIn.size(); i++){
+        inputs.push_back({inputSlot(input_names[i]), tIn[i]->data(), tIn[i]->shape(), false});
     }
 
-    auto output_tensors = session->Run(Ort::RunOptions{nullptr},
-                                       inputNames.data(),
-                                       inputTensors.data(),
-                                       numInputs,
-                                       outputNames.data(),
-                                       numOutputs);
+    std::vector<BoundTensor> outputs;
+    for (size_t i=0; i<tOut.size(); i++){
+        outputs.push_back({outputSlot(output_names[i]), tOut[i]->data(), tOut[i]->shape(),
+                           tOut[i]->layout() == eckit::linalg::TensorFloat::Layout::ColMajor});
+    }
 
-    // output tensors
-    ASSERT(output_tensors.size() == numOutputs);
+    if (!binding_) {
+        binding_.reset(new Ort::IoBinding(*session));
+    }
+    binding_->ClearBoundInputs();
+    binding_->ClearBoundOutputs();
 
-    eckit::Timing t_start(statistics_.timer());
-    for (size_t i=0; i<numOutputs; i++){
+    // the Ort values only wrap the tensor memory (no copy)
+    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
 
-         ASSERT(output_tensors[i].IsTensor());
+    ArenaVector<bool> inputBound(numInputs, false);
+    for (size_t i=0; i<tIn.size(); i++){
+
+        size_t slot = inputs[i].slot;
+        ASSERT(!inputBound[slot]);
+        inputBound[slot] = true;
+
+        auto shape_64 = utils::convert_shape<size_t, int64_t>(tIn[i]->shape(), ArenaAllocator<int64_t>());
+        Ort::Value value = Ort::Value::CreateTensor<float>(memory_info,
+                                                           tIn[i]->data(),
+                                                           tIn[i]->size(),
+                                                           shape_64.data(),
+                                                           shape_64.size());
+        ASSERT(value.IsTensor());
+        binding_->BindInput(inputNames[slot], value);
+    }
 
-         if (tOut[i]->layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
+    // only the requested outputs are bound (and so computed)
+    outputScratch_.resize(tOut.size());
+    for (size_t i=0; i<tOut.size(); i++){
 
-             // ONNX uses Left (C) tensor layouts, so we need to convert
-             auto out_shape = output_tensors[i].GetTensorTypeAndShapeInfo().GetShape();
-             TensorFloat tLeft(const_cast<float*>(output_tensors[i].GetTensorData<float>()),
-                               utils::convert_shape<int64_t, size_t>(out_shape),
-                               eckit::linalg::TensorFloat::Layout::RowMajor);  // wrap data
+        float* data = tOut[i]->data();
+        if (outputs[i].colMajor) {
+            outputScratch_[i].resize(tOut[i]->size());
+            data = outputScratch_[i].data();
+        } else {
+            std::vector<float>().swap(outputScratch_[i]);
+        }
 
-             TensorFloat tRight = tLeft.transformRowMajorToColMajor();
-             *tOut[i] = tRight;
-         }
-         else {
-             // ONNX uses Left (C) tensor layouts, so we can copy straight into memory of tOut
-             memcpy(tOut[i]->data(), output_tensors[i].GetTensorData<float>(),
-                    output_tensors[i].GetTensorTypeAndShapeInfo().GetElementCount() * sizeof(float));
-         }
+        auto shape_64 = utils::convert_shape<size_t, int64_t>(tOut[i]->shape(), ArenaAllocator<int64_t>());
+        Ort::Value value = Ort::Value::CreateTensor<float>(memory_info,
+                                                           data,
+                                                           tOut[i]->size(),
+                                                           shape_64.data(),
+                                                           shape_64.size());
+        ASSERT(value.IsTensor());
+        binding_->BindOutput(outputNames[outputs[i].slot], value);
     }
-    statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
 
+    boundInputs_  = std::move(inputs);
+    boundOutputs_ = std::move(outputs);
 }
 
 
@@ -202,6 +350,7 @@ void InferenceModelONNX::setupInputLayers() {
 
         char* inputName_ = session->GetInputName(i, allocator);
         inputNames.push_back(inputName_);
+        inputIndex[inputName_] = i;
 
         Ort::TypeInfo type_info = session->GetInputTypeInfo(i);
         Ort::Unowned<Ort::TensorTypeAndShapeInfo> tensor_info = type_info.GetTensorTypeAndShapeInfo();
@@ -221,6 +370,7 @@ void InferenceModelONNX::setupOutputLayers() {
 
         char* outputName_ = session->GetOutputName(i, allocator);
         outputNames.push_back(outputName_);
+        outputIndex[outputName_] = i;
 
         Ort::TypeInfo type_info = session->GetOutputTypeInfo(i);
         Ort::Unowned<Ort::TensorTypeAndShapeInfo> tensor_info = type_info.GetTensorTypeAndShapeInfo();
@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include <map>
 #include <string>
+#include <vector>
 
 #include "onnxruntime_cxx_api.h"
 
@@ -19,6 +21,12 @@
 
 namespace infero {
 
+/// ONNX Runtime model.
+///
+/// All the sessions of the process share one Ort::Env. By default each
+/// session has its own thread pools ("numInteropThreads", "numIntraopThreads");
+/// with INFERO_ONNX_GLOBAL_THREAD_POOLS=1 (or -onnx-global-thread-pools passed
+/// to infero_initialise) they all run on the global pools of the environment.
 class InferenceModelONNX : public InferenceModel {
 
 public:
@@ -43,10 +51,8 @@ private:
 
 private:
 
-    // ORT session
-    std::unique_ptr<Ort::Session> session;
-    std::unique_ptr<Ort::SessionOptions> session_options;
-    std::unique_ptr<Ort::Env> env;
+    // ORT session (possibly shared with other models, see sharedModel)
+    std::shared_ptr<Ort::Session> session;
 
     // allocator
     Ort::AllocatorWithDefaultOptions allocator;
@@ -55,21 +61,56 @@ private:
     size_t numInputs;
     std::vector<char*> inputNames;    
     std::vector<std::vector<int64_t>> inputLayerShapes;
+    std::map<std::string, size_t, std::less<>> inputIndex;
 
     // output interface
     size_t numOutputs;
     std::vector<char*> outputNames;
     std::vector<Ort::Value> outputTensors;
     std::vector<std::vector<int64_t>> outputLayerShapes;
+    std::map<std::string, size_t, std::less<>> outputIndex;
+
+    // model layer, memory and shape of a tensor bound to the session
+    struct BoundTensor {
+        size_t slot;
+        const float* data;
+        std::vector<size_t> shape;
+        bool colMajor;
+
+        bool matches(size_t s, const eckit::linalg::TensorFloat& t) const {
+            return slot == s && data == t.data() && shape == t.shape() &&
+                   colMajor == (t.layout() == eckit::linalg::TensorFloat::Layout::ColMajor);
+        }
+    };
+
+    // IO binding of the mimo path, re-bound only when the bound tensors change
+    std::unique_ptr<Ort::IoBinding> binding_;
+    std::vector<BoundTensor> boundInputs_;
+    std::vector<BoundTensor> boundOutputs_;
+
+    // RowMajor buffers bound in place of the ColMajor outputs
+    std::vector<std::vector<float>> outputScratch_;
 
 
 private:
 
     static eckit::LocalConfiguration defaultConfig();
 
+    /// load the model into a new ORT session
+    std::shared_ptr<Ort::Session> load();
+
     void setupInputLayers();
 
     void setupOutputLayers();
+
+    /// model layer (slot) of an input/output name
+    size_t inputSlot(const char* name) const;
+    size_t outputSlot(const char* name) const;
+
+    /// (re-)bind the tensors to the IO binding by layer name, unless already bound
+    void bindTensors(std::vector<eckit::linalg::TensorFloat*>& tIn, std::vector<const char*>& input_names,
+                     std::vector<eckit::linalg::TensorFloat*>& tOut, std::vector<const char*>& output_names);
+
     void print_shape(const Ort::Value& t);
 
 };
@@ -10,13 +10,18 @@
 
 #include <chrono>
 #include <cstdio>
+#include <exception>
+#include <filesystem>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 #include "eckit/log/Log.h"
 #include "eckit/mpi/Comm.h"
 
+#include "infero/infero_debug.h"
 #include "infero/models/InferenceModelTFC.h"
+#include "infero/models/SavedModelStage.h"
 #include "infero/infero_utils.h"
 #include "eckit/utils/StringTools.h"
 
@@ -33,11 +38,33 @@ void NoOpDeallocator(void* data, size_t a, void* b) {
 }
 
 
+struct InferenceModelTFC::Loaded {
+
+    TF_Graph* graph;
+    TF_SessionOptions* options;
+    TF_Session* session;
+
+    ~Loaded() {
+        TF_Status* status = TF_NewStatus();
+        if (session) {
+            TF_DeleteSession(session, status);
+            if (TF_GetCode(status) != TF_OK) {
+                Log::error() << "TF_DeleteSession: " << TF_Message(status) << std::endl;
+            }
+        }
+        TF_DeleteGraph(graph);
+        TF_DeleteSessionOptions(options);
+        TF_DeleteStatus(status);
+    }
+};
+
+
 eckit::LocalConfiguration InferenceModelTFC::defaultConfig() {
     static eckit::LocalConfiguration config;
     config.set("numInteropThreads", std::string{"1"});
     config.set("numIntraopThreads", std::string{"1"});
     config.set("device", std::string{"rank"});
+    config.set("stageDir", std::string{""});
     return config;
 }
 
@@ -45,207 +72,162 @@ eckit::LocalConfiguration InferenceModelTFC::defaultConfig() {
 InferenceModelTFC::InferenceModelTFC(const eckit::Configuration& conf) :
     InferenceModel(conf, InferenceModelTFC::defaultConfig()) {
 
-    // read/bcast model by mpi (when possible)
-    broadcast_model(modelPath());
-
-    network_graph = TF_NewGraph();
     err_status = TF_NewStatus();
-
-    // configure session options
-    configureSessionOptions();
-
-
     run_options = nullptr;
 
-    // if not null, use the model buffer
-    if (modelBuffer_.size()){
-
-        Log::info() << "Constructing TFC model from buffer not implemented" << std::endl;
-
-        NOTIMP;
-
-    } else {  // otherwise construct from model path
-
-        // default model serving tag
-        const char* tags = "serve";
-        int ntags = 1;
-
-        session = TF_LoadSessionFromSavedModel(session_options,
-                                               run_options,
-                                               modelPath().c_str(),
-                                               &tags,
-                                               ntags,
-                                               network_graph,
-                                               nullptr,
-                                               err_status);
-
-        check_status(err_status, "TF_LoadSessionFromSavedModel");
-    }
+    // graph and session are shared with the models of the same path and configuration
+    // (TF_SessionRun is thread-safe)
+    loaded_ = sharedModel<Loaded>([this] { return load(); });
 
+    network_graph   = loaded_->graph;
+    session_options = loaded_->options;
+    session         = loaded_->session;
 }
 
 InferenceModelTFC::~InferenceModelTFC() {
 
-    // Free memory
-    TF_DeleteGraph(network_graph);
+    stopAsync();
 
-    TF_DeleteSession(session, err_status);
-    check_status(err_status, "TF_DeleteSession");
-
-    TF_DeleteSessionOptions(session_options);
+    // (graph and session go with the last model using them)
     TF_DeleteStatus(err_status);
 }
 
-std::string InferenceModelTFC::name() const
-{
-    return std::string(this->type());
-}
-
-
-void InferenceModelTFC::infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut,
-                                   std::string input_name, std::string output_name) {
+std::shared_ptr<InferenceModelTFC::Loaded> InferenceModelTFC::load() {
 
-    // Input tensor
-    int NInputs = 1;
-
-    // array of outputs of input-operations
-    TF_Output* Input = static_cast<TF_Output*>(malloc(sizeof(TF_Output) * NInputs));
+    // read/bcast model by mpi (frozen GraphDef files only)
+    broadcast_model(modelPath());
 
-    // Try to figure out input layer
-    TF_Output t1 = GetInputOperationBuffer_(input_name);
-    Input[0] = t1;
+    network_graph = TF_NewGraph();
 
-    // Output tensor (NB: implicitely assumed that we only have one output!)
-    int NOutputs = 1;
+    // configure session options
+    configureSessionOptions();
 
-    // array of outputs of output-operations
-    TF_Output* Output = static_cast<TF_Output*>(malloc(sizeof(TF_Output) * NOutputs));
+    std::shared_ptr<Loaded> loaded(new Loaded{network_graph, session_options, nullptr});
 
-    // Try to figure out output layer
-    TF_Output t2 = GetOutputOperationBuffer_(output_name);
-    Output[0] = t2;
+    // if not null, import the (frozen) GraphDef from the model buffer
+    if (modelBuffer_.size()){
 
-    // Allocate array of ptrs for input & output tensors
-    TF_Tensor** InputValues = static_cast<TF_Tensor**>(malloc(sizeof(TF_Tensor*) * NInputs));
-    TF_Tensor** OutputValues = static_cast<TF_Tensor**>(malloc(sizeof(TF_Tensor*) * NOutputs));
+        TF_Buffer graphDef{modelBuffer_.data(), modelBuffer_.size(), nullptr};
 
-    // input rank and shape
-    size_t InputNdims = tIn.shape().size();
-    std::vector<int64_t> input_dims = utils::convert_shape<eckit::linalg::Size, int64_t>(tIn.shape());
+        TF_ImportGraphDefOptions* importOptions = TF_NewImportGraphDefOptions();
+        TF_GraphImportGraphDef(network_graph, &graphDef, importOptions, err_status);
+        TF_DeleteImportGraphDefOptions(importOptions);
+        check_status(err_status, "TF_GraphImportGraphDef");
 
-    size_t InputSize = sizeof(float) * tIn.size();
-    float* data = tIn.data();
+        loaded->session = TF_NewSession(network_graph, session_options, err_status);
+        check_status(err_status, "TF_NewSession");
 
-    TF_Tensor* InputTensor = TF_NewTensor(TF_FLOAT,
-                                          input_dims.data(),
-                                          static_cast<int>(InputNdims),
-                                          data,
-                                          InputSize,
-                                          &NoOpDeallocator,
-                                          nullptr);
-    INFERO_CHECK(InputTensor)
+        // (the graph holds its own copy)
+        modelBuffer_ = ModelBuffer();
 
-    InputValues[0] = InputTensor;
+    } else {  // otherwise construct from the SavedModel directory
 
-    // Run the Session
-    TF_SessionRun(session, nullptr,
-                  Input, InputValues, NInputs,
-                  Output, OutputValues, NOutputs,
-                  nullptr,
-                  0,
-                  nullptr,
-                  err_status);
-
-    check_status(err_status, "TF_SessionRun");
-
-    int OutputNdims = TF_GraphGetTensorNumDims(network_graph, *Output, err_status);
-    check_status(err_status, "TF_GraphGetTensorNumDims");
-
-    Log::info() << "N output dims: " << OutputNdims << std::endl;
+        // staged to node-local storage, when configured
+        std::unique_ptr<SavedModelStage> stage;
+        std::string path = modelPath();
+        if (!config().getString("stageDir").empty()) {
+            stage.reset(new SavedModelStage(modelPath(), config().getString("stageDir")));
+            path = stage->path();
+        }
 
-    int64_t* OutputDims = static_cast<int64_t*>(malloc(sizeof(int64_t) * OutputNdims));
-    TF_GraphGetTensorShape(network_graph,
-                           *Output,
-                           OutputDims,
-                           OutputNdims,
-                           err_status);
+        // default model serving tag
+        const char* tags = "serve";
+        int ntags = 1;
 
-    check_status(err_status, "TF_GraphGetTensorShape");
-    INFERO_CHECK(OutputDims)
+        // (a staged load fails on all the ranks together, see SavedModelStage::release)
+        std::exception_ptr error;
+        try {
+            loaded->session = TF_LoadSessionFromSavedModel(session_options,
+                                                           run_options,
+                                                           path.c_str(),
+                                                           &tags,
+                                                           ntags,
+                                                           network_graph,
+                                                           nullptr,
+                                                           err_status);
+
+            check_status(err_status, "TF_LoadSessionFromSavedModel");
+        }
+        catch (...) {
+            if (!stage) {
+                throw;
+            }
+            error = std::current_exception();
+        }
 
-    for (int i=0; i<OutputNdims; i++){
-        Log::info() << "N output dims: " << OutputDims[i] << std::endl;
+        // (variables are restored into the session, the copy is no longer needed)
+        if (stage) {
+            stage->release(error);
+        }
     }
 
-    // copy output data
-    Log::info() << "Copying output..." << std::endl;
-    void* buff = TF_TensorData(OutputValues[0]);
-    float* offsets = static_cast<float*>(buff);
+    return loaded;
+}
 
-    eckit::Timing t_start(statistics_.timer());
-    if (tOut.layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
+std::string InferenceModelTFC::name() const
+{
+    return std::string(this->type());
+}
 
-        // TFC uses Left (C) tensor layouts, so we need to convert
-        TensorFloat tLeft(offsets, tOut.shape(), eckit::linalg::TensorFloat::Layout::RowMajor);  // wrap data        
-        TensorFloat tRight = tLeft.transformRowMajorToColMajor();
-        tOut = tRight;
 
-    } else {
+void InferenceModelTFC::infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut,
+                                   std::string input_name, std::string output_name) {
 
-        // TFC uses Left (C) tensor layouts, so we can copy straight into memory of tOut
-        Log::info() << "output size " << tOut.size() << std::endl;
-        memcpy(tOut.data(), offsets, tOut.size() * sizeof(float));
-    }
-    statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
+    // one input and one output (default layers if no names are given)
+    eckit::linalg::TensorFloat* input  = &tIn;
+    eckit::linalg::TensorFloat* output = &tOut;
+    const char* iName                  = input_name.c_str();
+    const char* oName                  = output_name.c_str();
+
+    run(&input, &iName, 1, &output, &oName, 1);
 }
 
 
 void InferenceModelTFC::infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
                                         std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
 {
+    ASSERT(tIn.size() == input_names.size() && tOut.size() == output_names.size());
+    run(tIn.data(), input_names.data(), tIn.size(), tOut.data(), output_names.data(), tOut.size());
+}
 
-    // N Input tensors
-    size_t NInputs = input_names.size();
 
-    // array of outputs for input-operations
-    TF_Output* Input = static_cast<TF_Output*>(malloc(sizeof(TF_Output) * NInputs));
+void InferenceModelTFC::run(eckit::linalg::TensorFloat* const* tIn, const char* const* input_names, size_t NInputs,
+                            eckit::linalg::TensorFloat* const* tOut, const char* const* output_names, size_t NOutputs)
+{
+
+    // layers resolved (and input shapes checked) before any tensor is created
+    inputOps_.resize(NInputs);
     for (size_t i=0; i<NInputs; i++){
-        Input[i] = GetInputOperationBuffer_(input_names[i]);
+        const Layer& layer = inputLayer(input_names[i]);
+        checkShape(layer, tIn[i]->shape());
+        inputOps_[i] = layer.op;
     }
 
-    // N Output tensors
-    size_t NOutputs = output_names.size();
-
-    // array of outputs for output-operations
-    TF_Output* Output = static_cast<TF_Output*>(malloc(sizeof(TF_Output) * NOutputs));
-
-    std::cout << "NOutputs: " << NOutputs << std::endl;
+    outputOps_.resize(NOutputs);
     for (size_t i=0; i<NOutputs; i++){
-        Output[i] = GetOutputOperationBuffer_(output_names[i]);
+        outputOps_[i] = outputLayer(output_names[i]).op;
     }
 
-    // -----------------------------------------------
-    // input tensors
-    TF_Tensor** InputValues = static_cast<TF_Tensor**>(malloc(sizeof(TF_Tensor*) * NInputs));
-    for (size_t i=0; i<NInputs; i++){
-        InputValues[i] = TF_TensorFromData( tIn[i]->shape(), tIn[i]->data() );
-    }
+    // all the tensors are deleted on the way out, also when something throws
+    // (input tensors only wrap the user data, outputs are allocated by TF_SessionRun)
+    inputValues_.assign(NInputs, nullptr);
+    outputValues_.assign(NOutputs, nullptr);
+    TensorsGuard inputsGuard{inputValues_};
+    TensorsGuard outputsGuard{outputValues_};
 
-    // output tensors
-    TF_Tensor** OutputValues = static_cast<TF_Tensor**>(malloc(sizeof(TF_Tensor*) * NOutputs));
-    for (size_t i=0; i<NOutputs; i++){
-        OutputValues[i] = TF_TensorFromData( tOut[i]->shape(), tOut[i]->data() );
+    // N Input tensors
+    for (size_t i=0; i<NInputs; i++){
+        inputValues_[i] = TF_TensorFromData( tIn[i]->shape(), tIn[i]->data() );
     }
-    // -----------------------------------------------
 
     // ------------ Run the Session ------------------
     TF_SessionRun(session,
                   nullptr,
-                  Input,
-                  InputValues,
+                  inputOps_.data(),
+                  inputValues_.data(),
                   static_cast<int>(NInputs),
-                  Output,
-                  OutputValues,
+                  outputOps_.data(),
+                  outputValues_.data(),
                   static_cast<int>(NOutputs),
                   nullptr,
                   0,
@@ -260,44 +242,71 @@ void InferenceModelTFC::infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*>
     eckit::Timing t_start(statistics_.timer());
     for (size_t i=0; i<NOutputs; i++){
 
-        void* buff = TF_TensorData(*(OutputValues+i));
+        void* buff = TF_TensorData(outputValues_[i]);
         float* offsets = static_cast<float*>(buff);
 
-        if (tOut[i]->layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
+        // TFC uses Left (C) tensor layouts, re-ordered (if needed) straight into tOut
+        copyOutput(offsets, TF_TensorByteSize(outputValues_[i]) / sizeof(float), *tOut[i]);
+    }
+    statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
+    // -----------------------------------------------
 
-            Log::info() << i << "-th Output Tensor needs right-layout. "
-                        << "Transforming left to right.." << std::endl;
+}
 
-            // TFC uses Left (C) tensor layouts, so we need to convert
-            TensorFloat tLeft(offsets, tOut[i]->shape(), eckit::linalg::TensorFloat::Layout::RowMajor);  // wrap data
-            TensorFloat tRight = tLeft.transformRowMajorToColMajor();
-            *tOut[i] = tRight;
+InferenceModelTFC::TensorsGuard::~TensorsGuard() {
+    for (auto*& t: tensors) {
+        if (t) {
+            TF_DeleteTensor(t);
+            t = nullptr;
+        }
+    }
+}
 
-        } else {
+void InferenceModelTFC::checkShape(const Layer& layer, const std::vector<size_t>& shape) const {
 
-            // TFC uses Left (C) tensor layouts, so we can copy straight into memory of tOut
-            memcpy(tOut[i]->data(), offsets, tOut[i]->size() * sizeof(float));
-        }
+    // (no shape in the graph, or unknown rank)
+    if (layer.shape.empty()) {
+        return;
     }
-    statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
-    // -----------------------------------------------
 
-    free(Input);
-    free(Output);
+    bool ok = layer.shape.size() == shape.size();
+    for (size_t i = 0; ok && i < shape.size(); i++) {
+        ok = layer.shape[i] < 0 || static_cast<size_t>(layer.shape[i]) == shape[i];
+    }
 
-    // delete input tensors
-    for (size_t i=0; i<NInputs; i++){
-        TF_DeleteTensor( InputValues[i]);
+    if (!ok) {
+        std::ostringstream oss;
+        oss << "Input tensor shape [";
+        for (size_t i = 0; i < shape.size(); i++) {
+            oss << (i ? ", " : "") << shape[i];
+        }
+        oss << "] does not match layer " << TF_OperationName(layer.op.oper) << " shape [";
+        for (size_t i = 0; i < layer.shape.size(); i++) {
+            oss << (i ? ", " : "") << layer.shape[i];
+        }
+        oss << "] (-1 for any size)";
+        throw eckit::BadValue(oss.str(), Here());
     }
+}
 
-    // delete output tensors
-    for (size_t i=0; i<NOutputs; i++){
-        TF_DeleteTensor( OutputValues[i]);
+const InferenceModelTFC::Layer& InferenceModelTFC::inputLayer(const char* name) {
+
+    auto it = inputLayers_.find(name);
+    if (it == inputLayers_.end()) {
+        TF_Output op = GetInputOperationBuffer_(name);
+        it = inputLayers_.emplace(name, Layer{op, GetOperationShape_(op)}).first;
     }
+    return it->second;
+}
 
-    free(InputValues);
-    free(OutputValues);
+const InferenceModelTFC::Layer& InferenceModelTFC::outputLayer(const char* name) {
 
+    auto it = outputLayers_.find(name);
+    if (it == outputLayers_.end()) {
+        TF_Output op = GetOutputOperationBuffer_(name);
+        it = outputLayers_.emplace(name, Layer{op, GetOperationShape_(op)}).first;
+    }
+    return it->second;
 }
 
 void InferenceModelTFC::print(std::ostream &os) const
@@ -308,7 +317,7 @@ void InferenceModelTFC::print(std::ostream &os) const
 void InferenceModelTFC::check_status(const TF_Status* s, std::string name){
 
     if(TF_GetCode(s) == TF_OK) {
-        Log::info() << name << " OK" << std::endl;
+        INFERO_DEBUG_LOG << name << " OK" << std::endl;
     }
     else {
         Log::error() << name << " NOT OK" << std::endl;
@@ -321,31 +330,37 @@ TF_Output InferenceModelTFC::GetOperationBuffer_(std::string name, int op_id)
 
     // op output
     TF_Output t0{TF_GraphOperationByName(network_graph, name.c_str()), op_id};
+    INFERO_CHECK(t0.oper)
 
-    int t0_ndims = TF_GraphGetTensorNumDims(network_graph, t0, err_status);
-    check_status(err_status, "TF_GraphGetTensorNumDims");
-    Log::info() << "Layer " << name
-                << " [id=" << op_id << "]"
-                << " has " << t0_ndims
-                << " dims." << std::endl;
-
-    int64_t* t0_dims = static_cast<int64_t*>(malloc(sizeof(int64_t) * t0_ndims));
-    TF_GraphGetTensorShape(network_graph,
-                           t0,
-                           t0_dims,
-                           t0_ndims,
-                           err_status);
-
-    for (int i=0; i<t0_ndims; i++){
-        Log::info() << "N output dims: " << t0_dims[i] << std::endl;
-    }
+    return t0;
+
+}
 
-    check_status(err_status, "TF_GraphGetTensorShape");
+std::vector<int64_t> InferenceModelTFC::GetOperationShape_(TF_Output op)
+{
 
-    free(t0_dims);
+    int ndims = TF_GraphGetTensorNumDims(network_graph, op, err_status);
+    check_status(err_status, "TF_GraphGetTensorNumDims");
 
-    return t0;
+    std::vector<int64_t> dims(ndims > 0 ? ndims : 0);
+    if (!dims.empty()) {
+        TF_GraphGetTensorShape(network_graph,
+                               op,
+                               dims.data(),
+                               ndims,
+                               err_status);
+        check_status(err_status, "TF_GraphGetTensorShape");
+    }
 
+    Log::info() << "Layer " << TF_OperationName(op.oper)
+                << " [id=" << op.index << "]"
+                << " has shape: ";
+    for (auto d: dims){
+        Log::info() << d << ", ";
+    }
+    Log::info() << std::endl;
+
+    return dims;
 }
 
 TF_Output InferenceModelTFC::GetInputOperationBuffer_(std::string name)
@@ -421,7 +436,7 @@ TF_Tensor* InferenceModelTFC::TF_TensorFromData(const std::vector<size_t>& dims,
        prod *= d;
     }
     size_t InputSize = sizeof(float) * prod;
-    std::vector<int64_t> input_dims = utils::convert_shape<eckit::linalg::Size, int64_t>(dims);
+    ArenaVector<int64_t> input_dims = utils::convert_shape<eckit::linalg::Size, int64_t>(dims, ArenaAllocator<int64_t>());
 
     TF_Tensor* Tensor = TF_NewTensor(TF_FLOAT,
                                      input_dims.data(),
@@ -439,8 +454,11 @@ TF_Tensor* InferenceModelTFC::TF_TensorFromData(const std::vector<size_t>& dims,
 
 
 void InferenceModelTFC::broadcast_model(const std::string path) {
-  // Not available for this class, as TF_C needs to read a
-  // whole directory rather than a single file
+    // a SavedModel is a whole directory rather than a single file
+    // (see "stageDir"), only frozen GraphDef files are read here
+    if (!std::filesystem::is_directory(path)) {
+        InferenceModel::broadcast_model(path);
+    }
 }
 
 
@@ -10,7 +10,10 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "tensorflow/c/c_api.h"
 
@@ -19,6 +22,11 @@
 
 namespace infero {
 
+/// TensorFlow C API model: a SavedModel directory, or a frozen GraphDef file
+/// (read as selected by "modelBuffer").
+///
+/// With "stageDir" set, the SavedModel is read by MPI rank 0 only and copied
+/// under stageDir on each node (e.g. /dev/shm), see SavedModelStage.
 class InferenceModelTFC : public InferenceModel {
 
 public:
@@ -40,12 +48,19 @@ private:
     void infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
                          std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names) override;
 
+    /// runs the session (by layer name, empty for the default layers)
+    void run(eckit::linalg::TensorFloat* const* tIn, const char* const* input_names, size_t NInputs,
+             eckit::linalg::TensorFloat* const* tOut, const char* const* output_names, size_t NOutputs);
+
     void check_status(const TF_Status* s, std::string name);    
     TF_Tensor *TF_TensorFromData(const std::vector<size_t> &dims, float *data);
 
     /// Get an oeration tensor buffer from layer name
     TF_Output GetOperationBuffer_(std::string name, int op_id = 0);
 
+    /// Get the (graph) shape of an operation tensor
+    std::vector<int64_t> GetOperationShape_(TF_Output op);
+
     /// Get an oeration tensor buffer from layer name
     /// + contains specialised logic for input layer
     TF_Output GetInputOperationBuffer_(std::string name);
@@ -55,20 +70,56 @@ private:
     TF_Output GetOutputOperationBuffer_(std::string name);
 
 
-    virtual void broadcast_model(const std::string path);
+    /// resolved input/output layer (cached by the name passed by the caller),
+    /// with its graph shape (-1 for the dimensions of any size)
+    struct Layer {
+        TF_Output op;
+        std::vector<int64_t> shape;
+    };
+
+    const Layer& inputLayer(const char* name);
+    const Layer& outputLayer(const char* name);
+
+    /// throws BadValue if an input shape does not match the layer (graph) shape
+    void checkShape(const Layer& layer, const std::vector<size_t>& shape) const;
+
+    /// deletes the (non null) tensors of the array on scope exit
+    struct TensorsGuard {
+        std::vector<TF_Tensor*>& tensors;
+        ~TensorsGuard();
+    };
+
+    void broadcast_model(const std::string path) override;
 
     static eckit::LocalConfiguration defaultConfig();
 
     // configure session options from model configuration
     void configureSessionOptions();
 
+    /// graph, options and session loaded from the model path
+    struct Loaded;
+    std::shared_ptr<Loaded> load();
+
 private:
 
+    // (possibly shared, see sharedModel)
+    std::shared_ptr<Loaded> loaded_;
+
     TF_Session* session;
     TF_Graph* network_graph;
     TF_Status* err_status;
     TF_SessionOptions* session_options;
     TF_Buffer* run_options;
+
+    // layers already resolved in the graph (looked up without a string copy)
+    std::map<std::string, Layer, std::less<>> inputLayers_;
+    std::map<std::string, Layer, std::less<>> outputLayers_;
+
+    // argument arrays of TF_SessionRun, reused across calls
+    std::vector<TF_Output> inputOps_;
+    std::vector<TF_Output> outputOps_;
+    std::vector<TF_Tensor*> inputValues_;
+    std::vector<TF_Tensor*> outputValues_;
 };
 
 }  // namespace infero
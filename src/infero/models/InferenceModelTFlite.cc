@@ -8,12 +8,18 @@
  * nor does it submit to any jurisdiction.
  */
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
 
 #include "eckit/log/Log.h"
+#include "eckit/utils/StringTools.h"
 
+#include "infero/infero_debug.h"
 #include "infero/models/InferenceModelTFlite.h"
 #include "infero/infero_utils.h"
 
@@ -28,15 +34,90 @@ namespace infero {
 
 static InferenceModelBuilder<InferenceModelTFlite> tfliteBuilder;
 
+namespace {
+
+// alignment required by TFlite for custom tensor allocations
+constexpr size_t TFLITE_TENSOR_ALIGNMENT = 64;
+
+bool isAligned(const void* ptr) {
+    return reinterpret_cast<std::uintptr_t>(ptr) % TFLITE_TENSOR_ALIGNMENT == 0;
+}
+
+bool sameShape(const std::vector<size_t>& shape, const std::vector<int>& dims) {
+    return std::equal(shape.begin(), shape.end(), dims.begin(), dims.end(),
+                      [](size_t d, int i) { return d == static_cast<size_t>(i); });
+}
+
+}  // namespace
+
 eckit::LocalConfiguration InferenceModelTFlite::defaultConfig() {
     static eckit::LocalConfiguration config;
-    // empty defaults..
+    config.set("plannedShapes", std::string{""});
+    config.set("zeroCopy", std::string{"0"});
+    config.set("numThreads", std::string{"1"});
+    config.set("useXNNPACK", std::string{"0"});
     return config;
 }
 
 
 InferenceModelTFlite::InferenceModelTFlite(const eckit::Configuration& conf) :
-    InferenceModel(conf, InferenceModelTFlite::defaultConfig()) {
+    InferenceModel(conf, InferenceModelTFlite::defaultConfig()),
+    delegate_{nullptr, TfLiteXNNPackDelegateDelete},
+    zeroCopy_{config().getInt("zeroCopy") != 0} {
+
+    // the (read-only) model is shared with the models of the same path and configuration,
+    // each one has its own interpreter
+    model_ = sharedModel<tflite::FlatBufferModel>([this] { return load(); });
+
+    // Build the interpreter with the InterpreterBuilder.
+    int numThreads = config().getInt("numThreads");
+    ASSERT(numThreads >= 1);
+
+    tflite::ops::builtin::BuiltinOpResolver resolver;
+    tflite::InterpreterBuilder builder(*model_, resolver);
+    interpreter_ = std::unique_ptr<tflite::Interpreter>(new tflite::Interpreter);
+
+    builder(&interpreter_, numThreads);
+    INFERO_CHECK(interpreter_ != nullptr);
+
+    if (config().getInt("useXNNPACK")) {
+        applyXNNPACK(numThreads);
+    }
+
+    // Allocate tensor buffers.
+    INFERO_CHECK(interpreter_->AllocateTensors() == kTfLiteOk);
+
+    for (size_t i=0; i<interpreter_->inputs().size(); i++){
+        const TfLiteIntArray* dims = interpreter_->input_tensor(i)->dims;
+        inputShapes_.emplace_back(dims->data, dims->data + dims->size);
+    }
+
+    // plan for the expected input shapes upfront (if known)
+    std::vector<std::vector<int>> planned = plannedShapes();
+    if (!planned.empty()) {
+        ASSERT(planned.size() == inputShapes_.size());
+        resizeInputs(planned);
+    }
+
+    for (size_t i=0; i<interpreter_->outputs().size(); i++){
+        outputIndex_.emplace(interpreter_->output_tensor(i)->name, i);
+    }
+    outputsByIndex_.resize(interpreter_->outputs().size());
+
+    inputAllocations_.resize(interpreter_->inputs().size());
+    outputAllocations_.resize(interpreter_->outputs().size());
+
+    tflite::PrintInterpreterState(interpreter_.get());
+}
+
+std::shared_ptr<tflite::FlatBufferModel> InferenceModelTFlite::load() {
+
+    // a model built from a buffer does not own it
+    struct Loaded {
+        ModelBuffer buffer;
+        std::unique_ptr<tflite::FlatBufferModel> model;
+    };
+    std::shared_ptr<Loaded> loaded(new Loaded{ModelBuffer{}, nullptr});
 
     // read/bcast model by mpi (when possible)
     broadcast_model(modelPath());
@@ -46,29 +127,26 @@ InferenceModelTFlite::InferenceModelTFlite(const eckit::Configuration& conf) :
 
         Log::info() << "Constructing TFLITE model from buffer.." << std::endl;
         Log::info() << "Model expected size: " + std::to_string(modelBuffer_.size()) << std::endl;
-        model_ = tflite::FlatBufferModel::BuildFromBuffer((char*)modelBuffer_.data(),
-                                                          modelBuffer_.size());
+        loaded->buffer = modelBuffer_;
+        loaded->model  = tflite::FlatBufferModel::BuildFromBuffer(static_cast<const char*>(loaded->buffer.data()),
+                                                                  loaded->buffer.size());
 
     } else {  // otherwise construct from model path
-        model_ = tflite::FlatBufferModel::BuildFromFile( modelPath().c_str() );
+        loaded->model = tflite::FlatBufferModel::BuildFromFile( modelPath().c_str() );
     }
 
-    INFERO_CHECK(model_ != nullptr);
+    INFERO_CHECK(loaded->model != nullptr);
 
-    // Build the interpreter with the InterpreterBuilder.
-    tflite::ops::builtin::BuiltinOpResolver resolver;
-    tflite::InterpreterBuilder builder(*model_, resolver);
-    interpreter_ = std::unique_ptr<tflite::Interpreter>(new tflite::Interpreter);
+    return std::shared_ptr<tflite::FlatBufferModel>(loaded, loaded->model.get());
+}
 
-    builder(&interpreter_);
-    INFERO_CHECK(interpreter_ != nullptr);
+InferenceModelTFlite::~InferenceModelTFlite() {
 
-    // Allocate tensor buffers.
-    INFERO_CHECK(interpreter_->AllocateTensors() == kTfLiteOk);
-    tflite::PrintInterpreterState(interpreter_.get());
-}
+    stopAsync();
 
-InferenceModelTFlite::~InferenceModelTFlite() {}
+    // the delegate can only go after the interpreter
+    interpreter_.reset();
+}
 
 std::string InferenceModelTFlite::name() const
 {
@@ -79,128 +157,250 @@ std::string InferenceModelTFlite::name() const
 void InferenceModelTFlite::infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut,
                                       std::string input_name, std::string output_name) {
 
-    Log::info() << "TFlite inference " << std::endl;
+    // only one input/output usable here
+    eckit::linalg::TensorFloat* input  = &tIn;
+    eckit::linalg::TensorFloat* output = &tOut;
 
-    Log::info() << "Sample tensor shape: ";
-    for (auto i : tIn.shape())
-        Log::info() << i << ", ";
-    Log::info() << std::endl;
+    run(&input, 1, &output, 1);
+}
 
-    // reshape the internal input tensor to accept the user passed input
-    std::vector<int> sh_(tIn.shape().size());
-    for (int i = 0; i < tIn.shape().size(); i++)
-        sh_[i] = tIn.shape()[i];
 
-    interpreter_->ResizeInputTensor(interpreter_->inputs()[0], sh_);
-    interpreter_->AllocateTensors();
+void InferenceModelTFlite::infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
+                                           std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
+{
+    // tensors are matched to the model layers by position
+    ASSERT(tIn.size() == input_names.size());
+    for (size_t i=0; i<input_names.size(); i++){
+        ASSERT(std::strcmp(input_names[i], interpreter_->input_tensor(i)->name) == 0);
+    }
 
-    // =========================== copy tensor ============================
-    float* input      = interpreter_->typed_input_tensor<float>(0);
-    ::memcpy(input, tIn.data(), sizeof(float) * tIn.size());
-    // ====================================================================
+    // outputs are matched by name, or else by position
+    ASSERT(tOut.size() == output_names.size());
+    std::fill(outputsByIndex_.begin(), outputsByIndex_.end(), nullptr);
+    for (size_t i=0; i<output_names.size(); i++){
+        size_t index = outputIndex(output_names[i], i);
+        if (outputsByIndex_[index]) {
+            throw BadValue("TFlite output " + std::string(interpreter_->output_tensor(index)->name)
+                           + " requested twice", Here());
+        }
+        outputsByIndex_[index] = tOut[i];
+    }
 
-    // ========================== Run inference ===========================
-    INFERO_CHECK(interpreter_->Invoke() == kTfLiteOk);
+    run(tIn.data(), tIn.size(), outputsByIndex_.data(), outputsByIndex_.size());
+}
 
-//    printf("\n\n=== Post-invoke Interpreter State ===\n");
-//    tflite::PrintInterpreterState(interpreter_.get());
-    // ====================================================================
 
-    // ========================== Get output ==============================
-    float* output     = interpreter_->typed_output_tensor<float>(0);
-    TfLiteTensor* out = interpreter_->output_tensor(0);
+size_t InferenceModelTFlite::outputIndex(const char* name, size_t position) {
 
-    std::vector<size_t> out_shape(out->dims->size);
-    size_t out_size = 1;
-    for (int i = 0; i < out->dims->size; i++) {
-        out_shape[i] = out->dims->data[i];
-        out_size *= out_shape[i];
+    auto it = outputIndex_.find(name);
+    if (it != outputIndex_.end()) {
+        return it->second;
     }
 
-    Log::info() << "Output tensor shape: ";
-    for (auto i : out_shape)
-        Log::info() << i << ", ";
-    Log::info() << std::endl;
-
-    // copy output data
-    Log::info() << "Copying output..." << std::endl;
-    eckit::Timing t_start(statistics_.timer());
-    ASSERT(tOut.shape() == out_shape);
-    if (tOut.layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
-        // TFlite uses Left (C) tensor layouts, so we need to convert
-        TensorFloat tLeft(output, out_shape, eckit::linalg::TensorFloat::Layout::RowMajor);  // wrap data
-        TensorFloat tRight = tLeft.transformRowMajorToColMajor();
-        tOut = tRight;
+    if (position >= outputsByIndex_.size()) {
+        throw BadValue("TFlite model has no output named " + std::string(name), Here());
     }
-    else {
-        // TFlite uses Left (C) tensor layouts, so we can copy straight into memory of tOut
-        memcpy(tOut.data(), output, out_size * sizeof(float));
+
+    // (reported once per name)
+    if (unmatchedOutputs_.find(name) == unmatchedOutputs_.end()) {
+        unmatchedOutputs_.emplace(name);
+        Log::warning() << "TFlite model has no output named " << name << ", using output " << position
+                       << " (" << interpreter_->output_tensor(position)->name << ")" << std::endl;
     }
-    statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
-    // ====================================================================
+    return position;
 }
 
 
-void InferenceModelTFlite::infer_mimo_impl(std::vector<eckit::linalg::TensorFloat*> &tIn, std::vector<const char*> &input_names,
-                                           std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
-{
+void InferenceModelTFlite::run(eckit::linalg::TensorFloat* const* tIn, size_t NInputs,
+                               eckit::linalg::TensorFloat* const* tOut, size_t NOutputs) {
 
-    TfLiteStatus status_;
+    ASSERT(NInputs == inputShapes_.size());
 
-    // input tensors
-    size_t NInputs = input_names.size();
-    std::cout << "NInputs: " << NInputs << std::endl;
+    // reshape the internal input tensors to accept the user passed inputs
+    // (the TFlite shape is only built when it changes)
+    bool changed = false;
     for (size_t i=0; i<NInputs; i++){
-
-        ASSERT(input_names[i] == std::string(interpreter_->input_tensor(i)->name));
-        status_ = interpreter_->ResizeInputTensor(interpreter_->inputs()[i],
-                                                  utils::convert_shape<size_t, int>(tIn[i]->shape()) );
-
-        if(status_ != kTfLiteOk){
-            throw Exception("Input Tensor " + std::string(interpreter_->input_tensor(i)->name)
-                            + " failed to resize!");
+        if (!sameShape(tIn[i]->shape(), inputShapes_[i])) {
+            changed |= resizeInput(i, utils::convert_shape<size_t, int>(tIn[i]->shape()));
         }
     }
 
-    // Do the actual Input tensor allocation
-    interpreter_->AllocateTensors();
+    if (zeroCopy_) {
+        changed |= bindCustomAllocations(tIn, NInputs, tOut, NOutputs);
+    }
+
+    // re-plan the interpreter only when needed
+    if (changed) {
+        INFERO_DEBUG_LOG << "TFlite input shapes or bindings changed, allocating tensors.." << std::endl;
+        INFERO_CHECK(interpreter_->AllocateTensors() == kTfLiteOk);
+    }
 
-    // Copy input data in the model buffer
+    // =========================== copy tensors ===========================
+    // (unless the interpreter reads them in place)
     for (size_t i=0; i<NInputs; i++){
-        float* input = interpreter_->typed_tensor<float>(i);
+        float* input = interpreter_->typed_input_tensor<float>(i);
         ASSERT(input);
-        ::memcpy(input, tIn[i]->data(), sizeof(float) * tIn[i]->size());
+        if (input != tIn[i]->data()) {
+            ::memcpy(input, tIn[i]->data(), sizeof(float) * tIn[i]->size());
+        }
     }
+    // ====================================================================
 
-    // Run inference
+    // ========================== Run inference ===========================
     INFERO_CHECK(interpreter_->Invoke() == kTfLiteOk);
+    // ====================================================================
 
-    // copy output
-    size_t NOutputs = output_names.size();
+    // ========================== Get output ==============================
     eckit::Timing t_start(statistics_.timer());
     for (size_t i=0; i<NOutputs; i++){
 
-        std::cout << "Processing output: " << output_names[i] << std::endl;
-        std::cout << "--> got output with name: " << interpreter_->output_tensor(i)->name << std::endl;
+        // (outputs not requested by a mimo call)
+        if (!tOut[i]) {
+            continue;
+        }
+
+        float* output = interpreter_->typed_output_tensor<float>(i);
+        size_t size   = interpreter_->output_tensor(i)->bytes / sizeof(float);
+
+        // TFlite uses Left (C) tensor layouts, re-ordered (if needed) straight into tOut
+        if (output != tOut[i]->data()) {
+            copyOutput(output, size, *tOut[i]);
+        } else {
+            ASSERT(size == tOut[i]->size());
+        }
+    }
+    statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
+    // ====================================================================
+}
+
 
-        float* output     = interpreter_->typed_output_tensor<float>(i);
+bool InferenceModelTFlite::bindCustomAllocations(eckit::linalg::TensorFloat* const* tIn, size_t NInputs,
+                                                 eckit::linalg::TensorFloat* const* tOut, size_t NOutputs) {
 
-        // copy output data
-        Log::info() << "Copying output..." << std::endl;
+    // all the outputs are bound, so that the interpreter never
+    // keeps writing into user memory from a previous call
+    ASSERT(NOutputs == outputAllocations_.size());
 
-        if (tOut[i]->layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
-            // TFlite uses Left (C) tensor layouts, so we need to convert
-            TensorFloat tLeft(output, tOut[i]->shape(), eckit::linalg::TensorFloat::Layout::RowMajor);  // wrap data
-            TensorFloat tRight = tLeft.transformRowMajorToColMajor();
-            *tOut[i] = tRight;
+    bool changed = false;
+    for (size_t i=0; i<NInputs; i++){
+        if (inputAllocations_[i].bind(tIn[i]->data(), tIn[i]->size(), true)) {
+            INFERO_CHECK(interpreter_->SetCustomAllocationForTensor(interpreter_->inputs()[i],
+                                                                    inputAllocations_[i].allocation()) == kTfLiteOk);
+            changed = true;
         }
-        else {
-            // TFlite uses Left (C) tensor layouts, so we can copy straight into memory of tOut
-            memcpy(tOut[i]->data(), output, tOut[i]->size() * sizeof(float));
+    }
+
+    for (size_t i=0; i<NOutputs; i++){
+
+        ASSERT(tOut[i]);
+
+        // ColMajor outputs need re-ordering anyway
+        bool usable = tOut[i]->layout() == eckit::linalg::TensorFloat::Layout::RowMajor;
+        if (outputAllocations_[i].bind(tOut[i]->data(), tOut[i]->size(), usable)) {
+            INFERO_CHECK(interpreter_->SetCustomAllocationForTensor(interpreter_->outputs()[i],
+                                                                    outputAllocations_[i].allocation()) == kTfLiteOk);
+            changed = true;
         }
     }
 
-    statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
+    return changed;
+}
+
+
+bool InferenceModelTFlite::CustomAllocation::bind(float* data, size_t size, bool usable) {
+
+    void* ptr    = data;
+    size_t bytes = size * sizeof(float);
+
+    if (!usable || !isAligned(data)) {
+
+        // aligned scratch buffer, only grown when needed
+        size_t space = scratch_.size() * sizeof(float);
+        if (space < bytes + TFLITE_TENSOR_ALIGNMENT) {
+            scratch_.resize((bytes + TFLITE_TENSOR_ALIGNMENT) / sizeof(float) + 1);
+            space = scratch_.size() * sizeof(float);
+        }
+        ptr = scratch_.data();
+        ASSERT(std::align(TFLITE_TENSOR_ALIGNMENT, bytes, ptr, space));
+    }
+
+    if (ptr == data_ && bytes == bytes_) {
+        return false;
+    }
+
+    data_  = ptr;
+    bytes_ = bytes;
+    return true;
+}
+
+
+void InferenceModelTFlite::applyXNNPACK(int numThreads) {
+
+    TfLiteXNNPackDelegateOptions options = TfLiteXNNPackDelegateOptionsDefault();
+    options.num_threads = numThreads;
+
+    delegate_.reset(TfLiteXNNPackDelegateCreate(&options));
+    if (!delegate_) {
+        Log::warning() << "XNNPACK delegate could not be created, "
+                       << "using the builtin TFlite kernels" << std::endl;
+        return;
+    }
+
+    // ops not supported by XNNPACK stay on the builtin kernels,
+    // a delegation error leaves the interpreter usable as it was
+    TfLiteStatus status = interpreter_->ModifyGraphWithDelegate(delegate_.get());
+    if (status == kTfLiteOk) {
+        Log::info() << "XNNPACK delegate applied (" << numThreads << " threads)" << std::endl;
+    } else if (status == kTfLiteDelegateError) {
+        Log::warning() << "XNNPACK delegate could not be applied to this model, "
+                       << "using the builtin TFlite kernels" << std::endl;
+    } else {
+        throw eckit::SeriousBug("TFlite interpreter left unusable by the XNNPACK delegate", Here());
+    }
+}
+
+
+bool InferenceModelTFlite::resizeInput(size_t i, const std::vector<int>& shape) {
+
+    if (shape == inputShapes_[i]) {
+        return false;
+    }
+
+    if (interpreter_->ResizeInputTensor(interpreter_->inputs()[i], shape) != kTfLiteOk) {
+        throw Exception("Input Tensor " + std::string(interpreter_->input_tensor(i)->name)
+                        + " failed to resize!");
+    }
+    inputShapes_[i] = shape;
+    return true;
+}
+
+void InferenceModelTFlite::resizeInputs(const std::vector<std::vector<int>>& shapes) {
+
+    ASSERT(shapes.size() == inputShapes_.size());
+
+    bool resized = false;
+    for (size_t i=0; i<shapes.size(); i++){
+        resized |= resizeInput(i, shapes[i]);
+    }
+
+    // re-plan the interpreter only when needed
+    if (resized) {
+        INFERO_DEBUG_LOG << "TFlite input shapes changed, allocating tensors.." << std::endl;
+        INFERO_CHECK(interpreter_->AllocateTensors() == kTfLiteOk);
+    }
+}
+
+std::vector<std::vector<int>> InferenceModelTFlite::plannedShapes() const {
+
+    std::vector<std::vector<int>> shapes;
+    for (const auto& shape_str: eckit::StringTools::split(";", config().getString("plannedShapes"))) {
+        std::vector<int> shape;
+        for (const auto& d: eckit::StringTools::split(",", shape_str)) {
+            shape.push_back(std::stoi(d));
+        }
+        shapes.push_back(shape);
+    }
+    return shapes;
 }
 
 void InferenceModelTFlite::print(std::ostream &os) const
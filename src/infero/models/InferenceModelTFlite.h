@@ -10,8 +10,12 @@
 
 #pragma once
 
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
 #include "tensorflow/lite/interpreter.h"
 #include "tensorflow/lite/kernels/register.h"
 #include "tensorflow/lite/model.h"
@@ -45,9 +49,65 @@ private:
 
     static eckit::LocalConfiguration defaultConfig();
 
-    // TFlite model and interpreter
-    std::unique_ptr<tflite::FlatBufferModel> model_;
+    /// load the (read-only) model
+    std::shared_ptr<tflite::FlatBufferModel> load();
+
+    /// resize/bind the input and output tensors, copy the inputs, invoke and copy the outputs
+    void run(eckit::linalg::TensorFloat* const* tIn, size_t NInputs,
+             eckit::linalg::TensorFloat* const* tOut, size_t NOutputs);
+
+    /// zero-copy mode: point the interpreter tensors to the user memory (or to aligned scratch buffers)
+    /// (returns true if the interpreter needs re-planning)
+    bool bindCustomAllocations(eckit::linalg::TensorFloat* const* tIn, size_t NInputs,
+                               eckit::linalg::TensorFloat* const* tOut, size_t NOutputs);
+
+    /// index of an output by name, or its position if the model has no such output
+    size_t outputIndex(const char* name, size_t position);
+
+    /// resize the i-th input tensor if its shape changed (returns true if it did)
+    bool resizeInput(size_t i, const std::vector<int>& shape);
+
+    /// resize the input tensors (and re-plan the interpreter) only if their shape changed
+    void resizeInputs(const std::vector<std::vector<int>>& shapes);
+
+    /// input shapes to plan at construction ("plannedShapes": "d,d;d,d", one shape per input)
+    std::vector<std::vector<int>> plannedShapes() const;
+
+    /// apply the XNNPACK delegate (the interpreter keeps the builtin kernels on failure)
+    void applyXNNPACK(int numThreads);
+
+    // TFlite model, delegate (must outlive the interpreter) and interpreter
+    std::shared_ptr<tflite::FlatBufferModel> model_;  // (possibly shared, see sharedModel)
+    std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)> delegate_;
     std::unique_ptr<tflite::Interpreter> interpreter_;
+
+    // shape of the input tensors the interpreter is currently planned for
+    std::vector<std::vector<int>> inputShapes_;
+
+    // output tensors by name, and the outputs of a mimo call by model index (reused across calls)
+    std::map<std::string, size_t, std::less<>> outputIndex_;
+    std::set<std::string, std::less<>> unmatchedOutputs_;
+    std::vector<eckit::linalg::TensorFloat*> outputsByIndex_;
+
+    /// memory handed to the interpreter for one tensor (zero-copy mode)
+    class CustomAllocation {
+    public:
+        /// select the user memory if usable, an aligned scratch buffer otherwise
+        /// (returns true if the allocation changed)
+        bool bind(float* data, size_t size, bool usable);
+
+        TfLiteCustomAllocation allocation() const { return {data_, bytes_}; }
+
+    private:
+        void* data_   = nullptr;
+        size_t bytes_ = 0;
+        std::vector<float> scratch_;
+    };
+
+    // zero-copy mode (model_config "zeroCopy")
+    bool zeroCopy_;
+    std::vector<CustomAllocation> inputAllocations_;
+    std::vector<CustomAllocation> outputAllocations_;
 };
 
 }  // namespace infero
@@ -15,6 +15,7 @@
 #include "eckit/exception/Exceptions.h"
 #include "eckit/log/Log.h"
 
+#include "infero/infero_debug.h"
 #include "infero/models/InferenceModelTRT.h"
 
 
@@ -36,62 +37,53 @@ InferenceModelTRT::InferenceModelTRT(const eckit::Configuration& conf) :
     Engine_(nullptr), 
     Network_(nullptr) {
 
+    InferRuntime_ = nvinfer1::createInferRuntime(sample::gLogger.getTRTLogger());
+
+    // the engine is shared with the models of the same path and configuration,
+    // each inference runs in its own execution context
+    Engine_ = sharedModel<nvinfer1::ICudaEngine>([this] { return load(); });
+}
+
+std::shared_ptr<nvinfer1::ICudaEngine> InferenceModelTRT::load() {
+
+    std::shared_ptr<nvinfer1::ICudaEngine> engine;
+
     // read/bcast model by mpi (when possible)
     broadcast_model(modelPath());
 
-    InferRuntime_ = nvinfer1::createInferRuntime(sample::gLogger.getTRTLogger());
-
     // if not null, use the model buffer
     if (modelBuffer_.size()){
         Log::info() << "Constructing ONNX model from buffer.." << std::endl;
         Log::info() << "Model expected size: " + std::to_string(modelBuffer_.size()) << std::endl;
 
-        Engine_.reset(InferRuntime_->deserializeCudaEngine(modelBuffer_.data(), modelBuffer_.size()));
+        engine.reset(InferRuntime_->deserializeCudaEngine(modelBuffer_.data(), modelBuffer_.size()));
 
-        if (!Engine_) {
+        if (!engine) {
             std::string err = "failed to read the TRT engine!";
             throw eckit::FailedSystemCall(err, Here());
         }
 
     } else {  // otherwise construct from model path
 
-        // Resurrect the TRF model..
-        std::stringstream gieModelStream;
-        ifstream en(ModelPath.c_str());
-        gieModelStream << en.rdbuf();
-        en.close();
-
-        Log::info() << "Reading TRT model from " << ModelPath.c_str() << std::endl;
-
-        // support for stringstream deserialization was deprecated in TensorRT v2
-        // instead, read the stringstream into a memory buffer and pass that to TRT.
-        gieModelStream.seekg(0, std::ios::end);
-        const long int modelSize = gieModelStream.tellg();
-        gieModelStream.seekg(0, std::ios::beg);
-
-        modelMem_ = (char*)malloc(modelSize);
-        if (!modelMem_) {
-            std::string err = "failed to allocate " + std::to_string(modelSize) + " bytes";
-            throw eckit::FailedSystemCall(err, Here());
-        }
-
-        gieModelStream.read((char*)modelMem_, modelSize);
+        // deserialized straight from the mapped file
+        Log::info() << "Reading TRT model from " << modelPath() << std::endl;
+        ModelBuffer mapped = ModelBuffer::mapped(modelPath());
 
-        Engine_.reset(InferRuntime_->deserializeCudaEngine((void*)modelMem_, modelSize, NULL));
-        if (!Engine_) {
+        engine.reset(InferRuntime_->deserializeCudaEngine(mapped.data(), mapped.size()));
+        if (!engine) {
             std::string err = "failed to read the TRT engine!";
             throw eckit::FailedSystemCall(err, Here());
         }
 
-        Log::info() << "modelSize " << modelSize << std::endl;
+        Log::info() << "modelSize " << mapped.size() << std::endl;
 
     }
+
+    return engine;
 }
 
 InferenceModelTRT::~InferenceModelTRT() {
-
-    if (modelMem_)
-        delete modelMem_;
+    stopAsync();
 }
 
 std::string InferenceModelTRT::name() const
@@ -104,7 +96,7 @@ void InferenceModelTRT::infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linal
                                    std::string input_name, std::string output_name){
 
 
-    Log::info() << "TRT inference " << std::endl;
+    INFERO_DEBUG_LOG << "TRT inference " << std::endl;
 
     // =================== prediction ======================
     // Create RAII buffer manager object
@@ -122,7 +114,7 @@ void InferenceModelTRT::infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linal
     buffers.copyInputToDevice();
 
     // inference
-    Log::info() << "executing inference.." << std::endl;
+    INFERO_DEBUG_LOG << "executing inference.." << std::endl;
     bool status = context->executeV2(buffers.getDeviceBindings().data());
     if (!status) {
         throw eckit::SeriousBug("inference FAILED!", Here());
@@ -133,20 +125,12 @@ void InferenceModelTRT::infer_impl(eckit::linalg::TensorFloat& tIn, eckit::linal
     // ======================================================
 
     // ======================= output =======================    
-    Log::info() << "Copying output...";
+    INFERO_DEBUG_LOG << "Copying output...";
 
     eckit::Timing t_start(statistics_.timer());
     float* output = static_cast<float*>(buffers.getHostBuffer(output_tensor_name));    
-    if (tOut.layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
-        // TRT uses Left (C) tensor layouts, so we need to convert
-        eckit::linalg::TensorFloat tLeft(output, tOut.shape(), false);  // wrap data
-        eckit::linalg::TensorFloat tRight = tLeft.transformRowMajorToColMajor();
-        tOut = tRight;
-    }
-    else {
-        // TRT uses Left (C) tensor layouts, so we can copy straight into memory of tOut
-        ::memcpy(tOut.data(), output, tOut.size() * sizeof(float));
-    }
+    // TRT uses Left (C) tensor layouts, re-ordered (if needed) straight into tOut
+    copyOutput(output, tOut.size(), tOut);
     statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
     // ======================================================
 }
@@ -161,7 +145,7 @@ void infero::InferenceModelTRT::infer_mimo_impl(std::vector<eckit::linalg::Tenso
                                                 std::vector<eckit::linalg::TensorFloat*> &tOut, std::vector<const char*> &output_names)
 {
 
-    Log::info() << "TRT inference " << std::endl;
+    INFERO_DEBUG_LOG << "TRT inference " << std::endl;
 
     samplesCommon::BufferManager buffers(Engine_);
     auto context = SampleUniquePtr<nvinfer1::IExecutionContext>(Engine_->createExecutionContext());
@@ -180,7 +164,7 @@ void infero::InferenceModelTRT::infer_mimo_impl(std::vector<eckit::linalg::Tenso
     // Memcpy host 2 device
     buffers.copyInputToDevice();
 
-    Log::info() << "executing inference.." << std::endl;
+    INFERO_DEBUG_LOG << "executing inference.." << std::endl;
     bool status = context->executeV2(buffers.getDeviceBindings().data());
     if (!status) {
         throw eckit::SeriousBug("inference FAILED!", Here());
@@ -199,19 +183,8 @@ void infero::InferenceModelTRT::infer_mimo_impl(std::vector<eckit::linalg::Tenso
         // output buffer
         float* output = static_cast<float*>(buffers.getHostBuffer(output_names[i]));
 
-        if (tOut[i]->layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
-
-            // TFC uses Left (C) tensor layouts, so we need to convert
-            eckit::linalg::TensorFloat tLeft(output, tOut[i]->shape(), false);  // wrap data
-            eckit::linalg::TensorFloat tRight = tLeft.transformRowMajorToColMajor();
-            *tOut[i] = tRight;
-
-        } else {
-
-            // TFC uses Left (C) tensor layouts, so we can copy straight into memory of tOut
-            Log::info() << "output size " << tOut[i]->size() << std::endl;
-            ::memcpy(tOut[i]->data(), output, tOut[i]->size() * sizeof(float));
-        }
+        // TRT uses Left (C) tensor layouts, re-ordered (if needed) straight into tOut
+        copyOutput(output, tOut[i]->size(), *tOut[i]);
     }
     statistics_.oTensorLayoutTiming_ += eckit::Timing{statistics_.timer()} - t_start;
 }
@@ -77,6 +77,9 @@ private:
     // utility converter std::vector to TRT Dims
     static Dims Vector2Dims(std::vector<int>& vecdims);
 
+    /// deserialize the engine
+    std::shared_ptr<nvinfer1::ICudaEngine> load();
+
     static eckit::LocalConfiguration defaultConfig();
 
 private:
@@ -85,8 +88,6 @@ private:
     std::shared_ptr<nvinfer1::ICudaEngine> Engine_;  //!< The TensorRT engine used to run the network
 
     SampleUniquePtr<nvinfer1::INetworkDefinition> Network_;
-
-    char* modelMem_;
 };
 
 }  // namespace infero
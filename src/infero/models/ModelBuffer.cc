@@ -0,0 +1,292 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/io/SharedBuffer.h"
+#include "eckit/log/Log.h"
+#include "eckit/mpi/Comm.h"
+
+#include "infero/models/ModelBuffer.h"
+#include "infero/models/NodeComm.h"
+
+
+namespace infero {
+
+struct ModelBuffer::Storage {
+    virtual ~Storage() = default;
+
+    const void* data = nullptr;
+    size_t size      = 0;
+};
+
+
+namespace {
+
+/// bytes held in memory by an eckit buffer
+struct MemoryStorage : ModelBuffer::Storage {
+    explicit MemoryStorage(const eckit::SharedBuffer& b) : buffer(b) {
+        data = buffer.data();
+        size = buffer.size();
+    }
+    eckit::SharedBuffer buffer;
+};
+
+/// bytes of a memory mapping (unmapped with the storage)
+struct MappedStorage : ModelBuffer::Storage {
+    MappedStorage(const void* addr, size_t length) {
+        data = addr;
+        size = length;
+    }
+    ~MappedStorage() override { ::munmap(const_cast<void*>(data), size); }
+};
+
+
+constexpr size_t NAME_LENGTH = 256;
+
+/// maps (and with create, first creates) a shared memory segment, a created
+/// segment is unlinked again if it cannot be mapped
+void* mapSegment(const char* name, size_t size, bool create) {
+
+    int fd = create ? SYSCALL(::shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600))
+                    : SYSCALL(::shm_open(name, O_RDONLY, 0));
+
+    // (the memory is reserved now: a full /dev/shm fails here, not with a SIGBUS on first write)
+    int err = create ? ::posix_fallocate(fd, 0, static_cast<off_t>(size)) : 0;
+
+    void* addr = MAP_FAILED;
+    if (err == 0) {
+        addr = ::mmap(nullptr, size, create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        err  = (addr == MAP_FAILED) ? errno : 0;
+    }
+    ::close(fd);
+
+    if (err != 0) {
+        if (create) {
+            ::shm_unlink(name);
+        }
+        errno = err;
+        throw eckit::FailedSystemCall(std::string("Mapping shared memory segment ") + name + " of " +
+                                          std::to_string(size) + " bytes",
+                                      Here());
+    }
+    return addr;
+}
+
+/// mapping (and, if created here, name) of a shared memory segment, undone
+/// unless released
+struct SegmentGuard {
+    explicit SegmentGuard(const char* name) : name{name} {}
+
+    ~SegmentGuard() {
+        if (addr) {
+            ::munmap(addr, size);
+        }
+        if (created) {
+            ::shm_unlink(name);
+        }
+    }
+
+    SegmentGuard(const SegmentGuard&)            = delete;
+    SegmentGuard& operator=(const SegmentGuard&) = delete;
+
+    const char* name;
+    void* addr   = nullptr;
+    size_t size  = 0;
+    bool created = false;
+};
+
+void readFile(const std::string& path, char* data, size_t size) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw eckit::CantOpenFile(path);
+    }
+    in.read(data, static_cast<std::streamsize>(size));
+    if (static_cast<size_t>(in.gcount()) != size) {
+        throw eckit::SeriousBug("Short read of " + path, Here());
+    }
+}
+
+}  // namespace
+
+
+ModelBuffer::ModelBuffer() : storage_{std::make_shared<Storage>()} {}
+
+ModelBuffer::ModelBuffer(std::shared_ptr<const Storage> storage) : storage_{std::move(storage)} {}
+
+const void* ModelBuffer::data() const {
+    return storage_->data;
+}
+
+size_t ModelBuffer::size() const {
+    return storage_->size;
+}
+
+ModelBuffer ModelBuffer::broadcast(const std::string& path) {
+    return ModelBuffer(std::make_shared<MemoryStorage>(eckit::mpi::comm().broadcastFile(path, 0)));
+}
+
+ModelBuffer ModelBuffer::mapped(const std::string& path, bool populate, Advice advice) {
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw eckit::CantOpenFile(path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        throw eckit::FailedSystemCall("fstat of " + path, Here());
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        SYSCALL(::close(fd));
+        throw eckit::BadValue("Empty model file " + path, Here());
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (populate) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+
+    void* addr = ::mmap(nullptr, size, PROT_READ, flags, fd, 0);
+    SYSCALL(::close(fd));
+
+    if (addr == MAP_FAILED) {
+        throw eckit::FailedSystemCall("mmap of " + path, Here());
+    }
+
+    int hint = MADV_NORMAL;
+    switch (advice) {
+        case Advice::Sequential:
+            hint = MADV_SEQUENTIAL;
+            break;
+        case Advice::Random:
+            hint = MADV_RANDOM;
+            break;
+        case Advice::WillNeed:
+            hint = MADV_WILLNEED;
+            break;
+        default:
+            break;
+    }
+    if (hint != MADV_NORMAL && ::madvise(addr, size, hint) != 0) {
+        eckit::Log::warning() << "madvise failed on " << path << " (ignored)" << std::endl;
+    }
+
+    return ModelBuffer(std::make_shared<MappedStorage>(addr, size));
+}
+
+ModelBuffer ModelBuffer::nodeShared(const std::string& path) {
+
+    const eckit::mpi::Comm& world = eckit::mpi::comm();
+    const eckit::mpi::Comm& node  = nodeComm();
+
+    bool leader = (node.rank() == 0);
+
+    // each step is checked on all the ranks, so that a failure on one of them fails them all
+    std::exception_ptr error;
+    std::string what = "Loading model " + path + " in node shared memory";
+
+    size_t size = 0;
+    if (world.rank() == 0) {
+        try {
+            struct stat st;
+            SYSCALL(::stat(path.c_str(), &st));
+            size = static_cast<size_t>(st.st_size);
+            if (size == 0) {
+                throw eckit::BadValue("Empty model file " + path, Here());
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+    }
+    checkAllRanks(world, error, what);
+    world.broadcast(size, 0);
+
+    // segment named by the node leader
+    static size_t segments = 0;
+    std::vector<char> name(NAME_LENGTH, 0);
+    if (leader) {
+        std::snprintf(name.data(), name.size(), "/infero.%ld.%zu", static_cast<long>(::getpid()), segments++);
+    }
+    node.broadcast(name.data(), name.data() + name.size(), 0);
+
+    SegmentGuard segment(name.data());
+
+    if (leader) {
+        try {
+            segment.addr    = mapSegment(name.data(), size, true);
+            segment.size    = size;
+            segment.created = true;
+
+            // read on the first node, then sent to the others (leaders only)
+            if (world.rank() == 0) {
+                eckit::Log::info() << "Model " << path << " (" << size << " bytes) in node shared memory"
+                                   << std::endl;
+                readFile(path, static_cast<char*>(segment.addr), size);
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+    }
+    checkAllRanks(world, error, what);
+
+    if (leader) {
+        broadcastToNodeLeaders(static_cast<char*>(segment.addr), size);
+        try {
+            SYSCALL(::mprotect(segment.addr, size, PROT_READ));
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+    }
+    checkAllRanks(world, error, what);
+
+    if (!leader) {
+        try {
+            segment.addr = mapSegment(name.data(), size, false);
+            segment.size = size;
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+    }
+    checkAllRanks(world, error, what);
+
+    // all mapped: the name can go, the memory goes with the last mapping
+    auto storage    = std::make_shared<MappedStorage>(segment.addr, size);
+    segment.addr    = nullptr;
+    segment.created = false;
+    if (leader && ::shm_unlink(name.data()) != 0) {
+        eckit::Log::warning() << "shm_unlink of " << name.data() << " failed (ignored)" << std::endl;
+    }
+
+    return ModelBuffer(storage);
+}
+
+}  // namespace infero
@@ -0,0 +1,67 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+
+namespace infero {
+
+/// Read-only bytes of a model file, as handed to the backends.
+///
+/// Copies share the same storage, which is released with the last copy.
+/// An empty buffer (size 0) means that the backend reads the model by path.
+class ModelBuffer {
+
+public:
+
+    /// access pattern hint of a mapped file (madvise)
+    enum class Advice
+    {
+        Normal,
+        Sequential,
+        Random,
+        WillNeed
+    };
+
+    /// empty buffer
+    ModelBuffer();
+
+    /// file read by MPI rank 0 and broadcast: one private copy per rank
+    static ModelBuffer broadcast(const std::string& path);
+
+    /// file read by MPI rank 0 and broadcast to one POSIX shared memory
+    /// segment per node, mapped read-only by all the ranks of the node
+    /// (collective over the default communicator: a failure on any rank
+    /// fails them all, and leaves no segment behind)
+    static ModelBuffer nodeShared(const std::string& path);
+
+    /// file mapped read-only by this process (pages shared through the page
+    /// cache), optionally pre-faulted (MAP_POPULATE) and with an access hint
+    static ModelBuffer mapped(const std::string& path, bool populate = false, Advice advice = Advice::Normal);
+
+    const void* data() const;
+
+    size_t size() const;
+
+    /// (implemented by each kind of buffer)
+    struct Storage;
+
+private:
+
+    explicit ModelBuffer(std::shared_ptr<const Storage> storage);
+
+    std::shared_ptr<const Storage> storage_;
+};
+
+}  // namespace infero
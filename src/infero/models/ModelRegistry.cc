@@ -0,0 +1,50 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include "infero/models/ModelRegistry.h"
+
+
+namespace infero {
+
+ModelRegistry::ModelRegistry() : hits_{0} {}
+
+ModelRegistry& ModelRegistry::instance() {
+    static ModelRegistry theinstance;
+    return theinstance;
+}
+
+size_t ModelRegistry::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = 0;
+    for (const auto& e : entries_) {
+        if (!e.second.expired()) {
+            n++;
+        }
+    }
+    return n;
+}
+
+size_t ModelRegistry::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+void ModelRegistry::purge() {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->second.expired()) {
+            it = entries_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+}  // namespace infero
@@ -0,0 +1,81 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+
+
+namespace infero {
+
+/// Process-wide cache of the immutable part of the loaded models
+/// (weights, graphs, engine sessions that can run concurrently).
+///
+/// Entries are keyed by the model type, path and backend configuration (see
+/// InferenceModel::registryKey) and are only
+/// held weakly: they live as long as some model uses them, and are loaded
+/// again if requested after the last one has gone.
+class ModelRegistry {
+
+public:
+
+    static ModelRegistry& instance();
+
+    /// the live object registered under key, or a new one from make()
+    template <typename T>
+    std::shared_ptr<T> get(const std::string& key, const std::function<std::shared_ptr<T>()>& make) {
+
+        // (the type is part of the key, so that the cast below is safe)
+        std::string fullKey = key + '\n' + typeid(T).name();
+
+        // loading under the lock avoids loading the same model twice
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(fullKey);
+        if (it != entries_.end()) {
+            if (std::shared_ptr<void> entry = it->second.lock()) {
+                hits_++;
+                return std::static_pointer_cast<T>(entry);
+            }
+        }
+
+        purge();
+
+        std::shared_ptr<T> entry = make();
+        entries_[fullKey] = entry;
+        return entry;
+    }
+
+    /// number of models currently shared
+    size_t size() const;
+
+    /// number of loads avoided so far
+    size_t hits() const;
+
+private:
+
+    ModelRegistry();
+
+    /// drop the expired entries
+    void purge();
+
+private:
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::weak_ptr<void>> entries_;
+    size_t hits_;
+};
+
+}  // namespace infero
@@ -1,4 +1,5 @@
 #include "eckit/log/Log.h"
+#include "eckit/serialisation/Stream.h"
 
 #include "ModelStatistics.h"
 
@@ -6,16 +7,36 @@ using eckit::Log;
 
 namespace infero {
 
-ModelStatistics::ModelStatistics()
+ModelStatistics::ModelStatistics() :
+    iTensorBytesCopied_(0),
+    inferenceCount_(0),
+    iTensorReorderCount_(0),
+    oTensorReorderCount_(0)
 {
 
 }
 
+ModelStatistics& ModelStatistics::operator+=(const ModelStatistics& other)
+{
+    iTensorLayoutTiming_ += other.iTensorLayoutTiming_;
+    inferenceTiming_ += other.inferenceTiming_;
+    oTensorLayoutTiming_ += other.oTensorLayoutTiming_;
+    iTensorBytesCopied_ += other.iTensorBytesCopied_;
+    inferenceCount_ += other.inferenceCount_;
+    iTensorReorderCount_ += other.iTensorReorderCount_;
+    oTensorReorderCount_ += other.oTensorReorderCount_;
+    return *this;
+}
+
 void ModelStatistics::encode(eckit::Stream &s) const
 {
     s << iTensorLayoutTiming_;
     s << inferenceTiming_;
     s << oTensorLayoutTiming_;
+    s << iTensorBytesCopied_;
+    s << static_cast<unsigned long long>(inferenceCount_);
+    s << static_cast<unsigned long long>(iTensorReorderCount_);
+    s << static_cast<unsigned long long>(oTensorReorderCount_);
 }
 
 void ModelStatistics::report(std::ostream &out, const char *indent) const
@@ -25,9 +46,17 @@ void ModelStatistics::report(std::ostream &out, const char *indent) const
         << "========== Infero Model Statistics ========== "
         << std::endl;
 
+    reportCount(out, "INFERO-STATS: Inference calls           ", inferenceCount_, indent, true);
+
+    reportCount(out, "INFERO-STATS: Input tensors reordered   ", iTensorReorderCount_, indent, true);
+
+    reportCount(out, "INFERO-STATS: Output tensors reordered  ", oTensorReorderCount_, indent, true);
+
     reportTime(out, "INFERO-STATS: Time to copy/reorder Input ",
                iTensorLayoutTiming_, indent);
 
+    reportBytes(out, "INFERO-STATS: Bytes copied from Input   ", iTensorBytesCopied_, indent, true);
+
     reportTime(out, "INFERO-STATS: Time to execute inference  ", inferenceTiming_, indent);
 
     reportTime(out, "INFERO-STATS: Time to copy/reorder Output",
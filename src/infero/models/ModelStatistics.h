@@ -17,6 +17,17 @@ public:
     eckit::Timing iTensorLayoutTiming_;
     eckit::Timing oTensorLayoutTiming_;
 
+    // bytes of input data copied before reaching the backend
+    unsigned long long iTensorBytesCopied_;
+
+    // number of inference calls, and of input/output tensors re-ordered
+    size_t inferenceCount_;
+    size_t iTensorReorderCount_;
+    size_t oTensorReorderCount_;
+
+    /// accumulate the statistics of another session
+    ModelStatistics& operator+=(const ModelStatistics& other);
+
     void encode(eckit::Stream &s) const;
 
     void report(std::ostream &out, const char *indent = "") const;
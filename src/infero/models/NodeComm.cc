@@ -0,0 +1,101 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "infero/models/NodeComm.h"
+
+
+namespace infero {
+
+namespace {
+
+const char* NODE_COMM    = "infero.node";
+const char* LEADERS_COMM = "infero.node-leaders";
+
+constexpr size_t NAME_LENGTH = 256;
+
+// (MPI counts are int)
+constexpr size_t BCAST_CHUNK = size_t(1) << 30;
+
+std::string hostname() {
+    char name[NAME_LENGTH] = {0};
+    SYSCALL(::gethostname(name, NAME_LENGTH - 1));
+    return name;
+}
+
+void setupNodeComms() {
+
+    if (eckit::mpi::hasComm(NODE_COMM)) {
+        return;
+    }
+
+    std::string host = hostname();
+    int color        = static_cast<int>(std::hash<std::string>{}(host) & 0x7fffffff);
+    const eckit::mpi::Comm& node = eckit::mpi::comm().split(color, NODE_COMM);
+
+    // two nodes whose names hash alike would end up in the same communicator
+    // (checked by all the ranks together, so that they all fail alike)
+    std::vector<char> leaderHost(NAME_LENGTH, 0);
+    if (node.rank() == 0) {
+        std::copy(host.begin(), host.end(), leaderHost.begin());
+    }
+    node.broadcast(leaderHost.data(), leaderHost.data() + leaderHost.size(), 0);
+
+    int grouped = (host == leaderHost.data()) ? 1 : 0;
+    if (eckit::mpi::comm().allReduce(grouped, eckit::mpi::min()) == 0) {
+        eckit::mpi::deleteComm(NODE_COMM);
+        throw eckit::SeriousBug("Ranks of different hosts grouped as one node (host name hash collision), "
+                                "use modelBuffer: broadcast",
+                                Here());
+    }
+
+    eckit::mpi::comm().split(node.rank() == 0 ? 0 : 1, LEADERS_COMM);
+}
+
+}  // namespace
+
+
+const eckit::mpi::Comm& nodeComm() {
+    setupNodeComms();
+    return eckit::mpi::comm(NODE_COMM);
+}
+
+const eckit::mpi::Comm& nodeLeadersComm() {
+    setupNodeComms();
+    return eckit::mpi::comm(LEADERS_COMM);
+}
+
+void broadcastToNodeLeaders(char* data, size_t size) {
+    const eckit::mpi::Comm& leaders = nodeLeadersComm();
+    for (size_t offset = 0; offset < size; offset += BCAST_CHUNK) {
+        size_t n = std::min(BCAST_CHUNK, size - offset);
+        leaders.broadcast(data + offset, data + offset + n, 0);
+    }
+}
+
+void checkAllRanks(const eckit::mpi::Comm& comm, std::exception_ptr error, const std::string& what) {
+    int ok = error ? 0 : 1;
+    if (comm.allReduce(ok, eckit::mpi::min()) == 0) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        throw eckit::SeriousBug(what + " failed on another rank", Here());
+    }
+}
+
+}  // namespace infero
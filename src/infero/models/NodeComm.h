@@ -0,0 +1,38 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <string>
+
+#include "eckit/mpi/Comm.h"
+
+
+namespace infero {
+
+/// MPI communicators for node-level sharing, split from the default one
+/// (collectively, on first use)
+
+/// ranks of this node
+const eckit::mpi::Comm& nodeComm();
+
+/// first rank of each node (only meaningful on those ranks)
+const eckit::mpi::Comm& nodeLeadersComm();
+
+/// broadcast size bytes from the first node leader to the other leaders
+/// (in chunks that fit an MPI count)
+void broadcastToNodeLeaders(char* data, size_t size);
+
+/// collective over comm: rethrows the error of this rank, or fails too if another rank failed
+void checkAllRanks(const eckit::mpi::Comm& comm, std::exception_ptr error, const std::string& what);
+
+}  // namespace infero
@@ -0,0 +1,266 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "infero/models/RequestBatcher.h"
+#include "infero/models/TensorLayout.h"
+
+
+using eckit::linalg::TensorFloat;
+
+namespace infero {
+
+struct RequestBatcher::Request {
+
+    Tensors& tIn;
+    Names& inputNames;
+    Tensors& tOut;
+    Names& outputNames;
+
+    bool taken;  // part of a batch being run
+    bool done;
+    std::exception_ptr error;
+
+    /// extent of the batch dimension (0 if the request cannot be batched)
+    size_t rows() const {
+        size_t n = tIn.front()->shape().front();
+        for (const Tensors* ts : {&tIn, &tOut}) {
+            for (auto* t : *ts) {
+                if (t->shape().empty() || t->shape().front() != n) {
+                    return 0;
+                }
+            }
+        }
+        return n;
+    }
+
+    bool compatible(const Request& other) const {
+
+        auto sameNames = [](const Names& a, const Names& b) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); i++) {
+                if (std::strcmp(a[i], b[i]) != 0) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        auto sameShapes = [](const Tensors& a, const Tensors& b) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); i++) {
+                const auto& sa = a[i]->shape();
+                const auto& sb = b[i]->shape();
+                if (sa.size() != sb.size() || !std::equal(sa.begin() + 1, sa.end(), sb.begin() + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        return rows() && other.rows() && sameNames(inputNames, other.inputNames) &&
+               sameNames(outputNames, other.outputNames) && sameShapes(tIn, other.tIn) &&
+               sameShapes(tOut, other.tOut);
+    }
+};
+
+
+namespace {
+
+/// RowMajor tensor made of the i-th tensors of all the requests, stacked along dimension 0
+std::unique_ptr<TensorFloat> stack(const std::vector<RequestBatcher::Tensors*>& tensors, size_t i, size_t rows) {
+    std::vector<size_t> shape = (*tensors.front())[i]->shape();
+    shape.front()             = rows;
+    return std::unique_ptr<TensorFloat>(new TensorFloat(shape, TensorFloat::Layout::RowMajor));
+}
+
+}  // namespace
+
+
+RequestBatcher::RequestBatcher(size_t maxBatchSize, std::chrono::microseconds maxWait) :
+    maxBatchSize_{maxBatchSize}, maxWait_{maxWait}, collecting_{false} {
+    ASSERT(maxBatchSize_ >= 1);
+}
+
+RequestBatcher::~RequestBatcher() {
+    ASSERT(pending_.empty());
+}
+
+void RequestBatcher::submit(Tensors& tIn, Names& input_names, Tensors& tOut, Names& output_names,
+                            const Executor& run) {
+
+    ASSERT(!tIn.empty() && tIn.size() == input_names.size());
+    ASSERT(!tOut.empty() && tOut.size() == output_names.size());
+
+    Request request{tIn, input_names, tOut, output_names, false, false, nullptr};
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_.push_back(&request);
+    cv_.notify_all();
+
+    while (!request.done) {
+
+        if (request.taken || collecting_) {
+            cv_.wait(lock);
+            continue;
+        }
+
+        // lead the collection of the next batch
+        collecting_ = true;
+        cv_.wait_until(lock, std::chrono::steady_clock::now() + maxWait_,
+                       [this] { return pendingRows() >= maxBatchSize_; });
+
+        std::vector<Request*> batch = takeBatch();
+        for (auto* r : batch) {
+            r->taken = true;
+        }
+        collecting_ = false;
+        cv_.notify_all();
+
+        // run it while the next batch is collected
+        lock.unlock();
+        runBatch(batch, run);
+        lock.lock();
+
+        for (auto* r : batch) {
+            r->done = true;
+        }
+        cv_.notify_all();
+    }
+
+    if (request.error) {
+        std::rethrow_exception(request.error);
+    }
+}
+
+size_t RequestBatcher::pendingRows() const {
+
+    // a request that cannot be batched does not need to wait
+    if (!pending_.front()->rows()) {
+        return maxBatchSize_;
+    }
+
+    size_t rows = 0;
+    for (auto* r : pending_) {
+        if (r->compatible(*pending_.front())) {
+            rows += r->rows();
+        }
+    }
+    return rows;
+}
+
+std::vector<RequestBatcher::Request*> RequestBatcher::takeBatch() {
+
+    ASSERT(!pending_.empty());
+
+    // the oldest request always goes, the compatible ones join while they fit
+    std::vector<Request*> batch{pending_.front()};
+    pending_.pop_front();
+
+    size_t rows = batch.front()->rows();
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        if ((*it)->compatible(*batch.front()) && rows + (*it)->rows() <= maxBatchSize_) {
+            rows += (*it)->rows();
+            batch.push_back(*it);
+            it = pending_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    return batch;
+}
+
+void RequestBatcher::runBatch(std::vector<Request*>& batch, const Executor& run) {
+
+    try {
+
+        // nothing to coalesce: run on the caller's tensors
+        if (batch.size() == 1) {
+            Request& r = *batch.front();
+            run(r.tIn, r.inputNames, r.tOut, r.outputNames);
+            return;
+        }
+
+        size_t rows = 0;
+        std::vector<Tensors*> inputs;
+        std::vector<Tensors*> outputs;
+        for (auto* r : batch) {
+            rows += r->rows();
+            inputs.push_back(&r->tIn);
+            outputs.push_back(&r->tOut);
+        }
+
+        // gather the inputs (RowMajor)
+        std::vector<std::unique_ptr<TensorFloat>> stackedIn;
+        Tensors tIn;
+        for (size_t i = 0; i < inputs.front()->size(); i++) {
+
+            stackedIn.push_back(stack(inputs, i, rows));
+            float* dst = stackedIn.back()->data();
+
+            for (auto* ts : inputs) {
+                const TensorFloat& t = *(*ts)[i];
+                if (t.layout() == TensorFloat::Layout::ColMajor) {
+                    layout::colMajorToRowMajor(t.data(), dst, t.shape());
+                }
+                else {
+                    ::memcpy(dst, t.data(), t.size() * sizeof(float));
+                }
+                dst += t.size();
+            }
+            tIn.push_back(stackedIn.back().get());
+        }
+
+        std::vector<std::unique_ptr<TensorFloat>> stackedOut;
+        Tensors tOut;
+        for (size_t i = 0; i < outputs.front()->size(); i++) {
+            stackedOut.push_back(stack(outputs, i, rows));
+            tOut.push_back(stackedOut.back().get());
+        }
+
+        Request& first = *batch.front();
+        run(tIn, first.inputNames, tOut, first.outputNames);
+
+        // scatter the outputs
+        for (size_t i = 0; i < tOut.size(); i++) {
+
+            const float* src = tOut[i]->data();
+
+            for (auto* ts : outputs) {
+                TensorFloat& t = *(*ts)[i];
+                if (t.layout() == TensorFloat::Layout::ColMajor) {
+                    layout::rowMajorToColMajor(src, t.data(), t.shape());
+                }
+                else {
+                    ::memcpy(t.data(), src, t.size() * sizeof(float));
+                }
+                src += t.size();
+            }
+        }
+    }
+    catch (...) {
+        for (auto* r : batch) {
+            r->error = std::current_exception();
+        }
+    }
+}
+
+}  // namespace infero
@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "eckit/linalg/Tensor.h"
+
+
+namespace infero {
+
+/// Coalesces concurrent MIMO inference requests into batched engine runs.
+///
+/// The first caller that finds no batch being collected becomes the leader:
+/// it waits (up to maxWait) for more requests to arrive, takes the compatible
+/// ones (up to maxBatchSize rows), concatenates them along dimension 0,
+/// runs them at once and scatters the results back to each caller's outputs.
+/// The other callers just wait for their request to be done. Requests are
+/// compatible if they use the same tensor names and the same shapes, except
+/// for the (leading) batch dimension.
+class RequestBatcher {
+
+public:
+
+    using Tensors = std::vector<eckit::linalg::TensorFloat*>;
+    using Names   = std::vector<const char*>;
+
+    /// runs one (possibly batched) request
+    using Executor = std::function<void(Tensors& tIn, Names& input_names, Tensors& tOut, Names& output_names)>;
+
+    RequestBatcher(size_t maxBatchSize, std::chrono::microseconds maxWait);
+
+    ~RequestBatcher();
+
+    /// run a request as part of a batch (blocks until its outputs are written)
+    void submit(Tensors& tIn, Names& input_names, Tensors& tOut, Names& output_names, const Executor& run);
+
+private:
+
+    struct Request;
+
+    size_t pendingRows() const;
+
+    std::vector<Request*> takeBatch();
+
+    static void runBatch(std::vector<Request*>& batch, const Executor& run);
+
+private:
+
+    size_t maxBatchSize_;
+    std::chrono::microseconds maxWait_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Request*> pending_;
+    bool collecting_;
+};
+
+}  // namespace infero
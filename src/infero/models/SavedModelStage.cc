@@ -0,0 +1,273 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/log/Log.h"
+#include "eckit/mpi/Comm.h"
+
+#include "infero/models/NodeComm.h"
+#include "infero/models/SavedModelStage.h"
+
+
+namespace fs = std::filesystem;
+
+namespace infero {
+
+namespace {
+
+// archive: magic, then one entry per directory/file:
+//   type ('d'|'f'), uint64 length of the relative path, path,
+//   and for files: uint64 size, content
+const char MAGIC[]          = "INFEROAR";
+constexpr size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+
+constexpr size_t NAME_LENGTH = 4096;
+
+void append(std::vector<char>& out, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+void appendSize(std::vector<char>& out, uint64_t n) {
+    append(out, &n, sizeof(n));
+}
+
+/// bounds-checked reading of an archive
+class Reader {
+public:
+    Reader(const char* data, size_t size) : data_{data}, size_{size}, pos_{0} {}
+
+    bool end() const { return pos_ == size_; }
+
+    const char* take(size_t n) {
+        if (n > size_ - pos_) {
+            throw eckit::BadValue("Truncated model archive", Here());
+        }
+        const char* p = data_ + pos_;
+        pos_ += n;
+        return p;
+    }
+
+    uint64_t size() {
+        uint64_t n;
+        std::memcpy(&n, take(sizeof(n)), sizeof(n));
+        return n;
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t pos_;
+};
+
+}  // namespace
+
+
+std::vector<char> SavedModelStage::pack(const std::string& dir) {
+
+    if (!fs::is_directory(dir)) {
+        throw eckit::BadValue("Not a model directory: " + dir, Here());
+    }
+
+    std::vector<char> out;
+    append(out, MAGIC, MAGIC_SIZE);
+
+    // (parents are listed before their content)
+    for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+
+        std::string name = fs::relative(entry.path(), dir).generic_string();
+
+        if (entry.is_directory()) {
+            out.push_back('d');
+            appendSize(out, name.size());
+            append(out, name.data(), name.size());
+        }
+        else if (entry.is_regular_file()) {
+            size_t size = static_cast<size_t>(entry.file_size());
+
+            out.push_back('f');
+            appendSize(out, name.size());
+            append(out, name.data(), name.size());
+            appendSize(out, size);
+
+            size_t offset = out.size();
+            out.resize(offset + size);
+
+            std::ifstream in(entry.path(), std::ios::binary);
+            if (!in) {
+                throw eckit::CantOpenFile(entry.path().string());
+            }
+            in.read(out.data() + offset, static_cast<std::streamsize>(size));
+            if (static_cast<size_t>(in.gcount()) != size) {
+                throw eckit::SeriousBug("Short read of " + entry.path().string(), Here());
+            }
+        }
+    }
+
+    return out;
+}
+
+void SavedModelStage::unpack(const char* data, size_t size, const std::string& dir) {
+
+    Reader in(data, size);
+    if (std::memcmp(in.take(MAGIC_SIZE), MAGIC, MAGIC_SIZE) != 0) {
+        throw eckit::BadValue("Not a model archive", Here());
+    }
+
+    fs::create_directories(dir);
+
+    while (!in.end()) {
+
+        char type       = *in.take(1);
+        uint64_t length = in.size();
+        fs::path name(std::string(in.take(length), length));
+
+        // entries stay under dir
+        if (name.empty() || name.is_absolute() || *name.lexically_normal().begin() == "..") {
+            throw eckit::BadValue("Invalid path in model archive: " + name.string(), Here());
+        }
+
+        fs::path path = fs::path(dir) / name;
+
+        if (type == 'd') {
+            fs::create_directories(path);
+        }
+        else if (type == 'f') {
+            uint64_t n        = in.size();
+            const char* bytes = in.take(n);
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(bytes, static_cast<std::streamsize>(n));
+            if (!out) {
+                throw eckit::WriteError("Cannot write " + path.string(), Here());
+            }
+        }
+        else {
+            throw eckit::BadValue("Invalid entry in model archive", Here());
+        }
+    }
+}
+
+
+SavedModelStage::SavedModelStage(const std::string& modelDir, const std::string& scratchDir) {
+
+    const eckit::mpi::Comm& world = eckit::mpi::comm();
+    const eckit::mpi::Comm& node  = nodeComm();
+
+    leader_ = (node.rank() == 0);
+
+    // read on the first node, then sent to the others (leaders only)
+    // (a step failing on some ranks fails on all of them, after the others have caught up)
+    std::vector<char> archive;
+    std::exception_ptr error;
+    if (world.rank() == 0) {
+        try {
+            archive = pack(modelDir);
+            eckit::Log::info() << "Model " << modelDir << " (" << archive.size() << " bytes) staged under "
+                               << scratchDir << std::endl;
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+    }
+    checkAllRanks(world, error, "Packing model " + modelDir);
+
+    size_t size = archive.size();
+    world.broadcast(size, 0);
+
+    // copy named by the node leader
+    static size_t stages = 0;
+    std::vector<char> name(NAME_LENGTH, 0);
+    if (leader_) {
+        std::snprintf(name.data(), name.size(), "%s/infero-model.%ld.%zu", scratchDir.c_str(),
+                      static_cast<long>(::getpid()), stages++);
+    }
+    node.broadcast(name.data(), name.data() + name.size(), 0);
+    std::string path = name.data();
+
+    if (leader_) {
+        archive.resize(size);
+        broadcastToNodeLeaders(archive.data(), size);
+
+        try {
+            if (fs::exists(path)) {
+                throw eckit::SeriousBug("Model staging directory " + path + " already exists", Here());
+            }
+            try {
+                unpack(archive.data(), size, path);
+            }
+            catch (...) {
+                std::error_code ec;
+                fs::remove_all(path, ec);
+                throw;
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    // (the copies of the other nodes are removed if one of them failed)
+    try {
+        checkAllRanks(world, error, "Staging model " + modelDir);
+    }
+    catch (...) {
+        if (leader_ && !error) {
+            std::error_code ec;
+            fs::remove_all(path, ec);
+        }
+        throw;
+    }
+
+    path_ = path;
+}
+
+SavedModelStage::~SavedModelStage() {
+    if (leader_ && !path_.empty()) {
+        std::error_code ec;
+        fs::remove_all(path_, ec);
+    }
+}
+
+void SavedModelStage::release(std::exception_ptr error) {
+
+    // (collective: all the ranks are done with the copy once they are all here)
+    std::exception_ptr failure;
+    try {
+        checkAllRanks(eckit::mpi::comm(), error, "Loading staged model");
+    }
+    catch (...) {
+        failure = std::current_exception();
+    }
+
+    if (leader_) {
+        std::error_code ec;
+        fs::remove_all(path_, ec);
+        if (ec) {
+            eckit::Log::warning() << "Staged model " << path_ << " not removed: " << ec.message() << std::endl;
+        }
+    }
+    path_.clear();
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+}  // namespace infero
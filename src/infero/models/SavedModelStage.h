@@ -0,0 +1,62 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <vector>
+
+
+namespace infero {
+
+/// Copy of a model directory (e.g. a TF SavedModel) on node-local storage.
+///
+/// The directory is read once, by MPI rank 0, and packed into a single archive
+/// that is broadcast to the first rank of each node, which unpacks it under
+/// a scratch directory (e.g. a tmpfs such as /dev/shm). All the ranks of the
+/// node then load the model from there.
+///
+/// Construction and release() are collective over the default communicator:
+/// a step failing on some ranks makes all of them throw (so that none is left
+/// waiting for the others), and release() takes the load error of each rank.
+class SavedModelStage {
+
+public:
+
+    SavedModelStage(const std::string& modelDir, const std::string& scratchDir);
+
+    /// removes the copy if not released (not collective)
+    ~SavedModelStage();
+
+    SavedModelStage(const SavedModelStage&)            = delete;
+    SavedModelStage& operator=(const SavedModelStage&) = delete;
+
+    /// directory to load the model from
+    const std::string& path() const { return path_; }
+
+    /// waits for all the ranks to have loaded the model (or failed to, error),
+    /// removes the copy, and throws on all the ranks if any of them failed
+    void release(std::exception_ptr error = nullptr);
+
+    /// archive of the files and sub-directories of dir
+    static std::vector<char> pack(const std::string& dir);
+
+    /// recreates the content of an archive under dir
+    static void unpack(const char* data, size_t size, const std::string& dir);
+
+private:
+
+    std::string path_;
+    bool leader_;
+};
+
+}  // namespace infero
@@ -0,0 +1,100 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include "eckit/exception/Exceptions.h"
+
+#include "infero/models/SessionPool.h"
+
+
+namespace infero {
+
+namespace {
+
+constexpr uint64_t TAG_SHIFT = 32;
+constexpr uint64_t SLOT_MASK = (uint64_t{1} << TAG_SHIFT) - 1;
+
+inline uint64_t next_head(uint64_t head, uint64_t slot_plus_one) {
+    return (((head >> TAG_SHIFT) + 1) << TAG_SHIFT) | slot_plus_one;
+}
+
+}  // namespace
+
+
+SessionPool::SessionPool(size_t size) :
+    head_{0},
+    next_(size),
+    waiters_{0} {
+
+    ASSERT(size >= 1);
+    ASSERT(size < SLOT_MASK);
+
+    // initially all the slots are free: 0 -> 1 -> ... -> size-1
+    for (size_t i = 0; i < size; i++) {
+        next_[i].store(static_cast<uint32_t>(i + 1 < size ? i + 2 : 0));
+    }
+    head_.store(1);
+}
+
+SessionPool::~SessionPool() {}
+
+size_t SessionPool::acquire() {
+
+    size_t slot;
+    if (tryPop(slot)) {
+        return slot;
+    }
+
+    // pool exhausted: wait for a release
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++waiters_;
+    cv_.wait(lock, [this, &slot] { return tryPop(slot); });
+    --waiters_;
+
+    return slot;
+}
+
+void SessionPool::release(size_t slot) {
+
+    ASSERT(slot < next_.size());
+    push(slot);
+
+    if (waiters_.load() > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+}
+
+bool SessionPool::tryPop(size_t& slot) {
+
+    uint64_t head = head_.load();
+    while (true) {
+
+        uint64_t top = head & SLOT_MASK;
+        if (top == 0) {
+            return false;
+        }
+
+        uint64_t next = next_[top - 1].load(std::memory_order_relaxed);
+        if (head_.compare_exchange_weak(head, next_head(head, next))) {
+            slot = static_cast<size_t>(top - 1);
+            return true;
+        }
+    }
+}
+
+void SessionPool::push(size_t slot) {
+
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    do {
+        next_[slot].store(static_cast<uint32_t>(head & SLOT_MASK), std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(head, next_head(head, slot + 1)));
+}
+
+}  // namespace infero
@@ -0,0 +1,63 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+namespace infero {
+
+/// Pool of session slots [0, size), handed out through a lock-free free-list.
+///
+/// The free-list is a tagged Treiber stack, so acquire/release never take a lock
+/// while a slot is available. Only callers that find the pool empty fall back
+/// to blocking on a condition variable until a slot is released.
+class SessionPool {
+
+public:
+
+    explicit SessionPool(size_t size);
+
+    ~SessionPool();
+
+    /// take a free slot (blocks if all the slots are in use)
+    size_t acquire();
+
+    /// give a slot back to the pool
+    void release(size_t slot);
+
+    size_t size() const { return next_.size(); }
+
+private:
+
+    bool tryPop(size_t& slot);
+
+    void push(size_t slot);
+
+private:
+
+    // head of the free-list: (ABA tag << 32) | (slot + 1), slot + 1 == 0 if empty
+    std::atomic<uint64_t> head_;
+
+    // next free slot (+1) after each slot in the free-list
+    std::vector<std::atomic<uint32_t>> next_;
+
+    // slow path, only used when the pool is exhausted
+    std::atomic<size_t> waiters_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+}  // namespace infero
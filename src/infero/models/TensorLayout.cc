@@ -0,0 +1,360 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "infero/models/Arena.h"
+#include "infero/models/TensorLayout.h"
+
+
+namespace infero {
+namespace layout {
+
+namespace {
+
+// side of the cache blocks (in elements)
+constexpr size_t BLOCK = 64;
+
+
+/// scalar transpose of a (small) rows x cols tile
+template <typename S, typename D>
+inline void transpose_tile(const S* src, size_t lds, D* dst, size_t ldd, size_t rows, size_t cols) {
+    for (size_t c = 0; c < cols; c++) {
+        for (size_t r = 0; r < rows; r++) {
+            dst[c * ldd + r] = static_cast<D>(src[r * lds + c]);
+        }
+    }
+}
+
+
+#if defined(__AVX2__)
+
+/// in-register 8x8 float transpose (row i of the tile in, column i out)
+inline void transpose8x8(__m256 r[8]) {
+
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44);
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44);
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+/// 8x8 double -> float transpose, converting on load
+inline void transpose_kernel8(const double* src, size_t lds, float* dst, size_t ldd) {
+    __m256 r[8];
+    for (size_t i = 0; i < 8; i++) {
+        __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i * lds));
+        __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i * lds + 4));
+        r[i]      = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    }
+    transpose8x8(r);
+    for (size_t i = 0; i < 8; i++) {
+        _mm256_storeu_ps(dst + i * ldd, r[i]);
+    }
+}
+
+/// 8x8 float -> double transpose, converting on store
+inline void transpose_kernel8(const float* src, size_t lds, double* dst, size_t ldd) {
+    __m256 r[8];
+    for (size_t i = 0; i < 8; i++) {
+        r[i] = _mm256_loadu_ps(src + i * lds);
+    }
+    transpose8x8(r);
+    for (size_t i = 0; i < 8; i++) {
+        _mm256_storeu_pd(dst + i * ldd, _mm256_cvtps_pd(_mm256_castps256_ps128(r[i])));
+        _mm256_storeu_pd(dst + i * ldd + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(r[i], 1)));
+    }
+}
+
+#endif
+
+
+#if defined(__AVX512F__)
+
+constexpr size_t KERNEL = 16;
+
+/// 16x16 float transpose in registers
+inline void transpose_kernel(const float* src, size_t lds, float* dst, size_t ldd) {
+
+    __m512 r[16];
+    for (size_t i = 0; i < 16; i++) {
+        r[i] = _mm512_loadu_ps(src + i * lds);
+    }
+
+    // interleave pairs of rows
+    __m512 t[16];
+    for (size_t i = 0; i < 16; i += 2) {
+        t[i]     = _mm512_unpacklo_ps(r[i], r[i + 1]);
+        t[i + 1] = _mm512_unpackhi_ps(r[i], r[i + 1]);
+    }
+
+    // 4x4 transposes within each 128-bit lane
+    __m512 u[16];
+    for (size_t i = 0; i < 16; i += 4) {
+        u[i]     = _mm512_shuffle_ps(t[i], t[i + 2], 0x44);
+        u[i + 1] = _mm512_shuffle_ps(t[i], t[i + 2], 0xEE);
+        u[i + 2] = _mm512_shuffle_ps(t[i + 1], t[i + 3], 0x44);
+        u[i + 3] = _mm512_shuffle_ps(t[i + 1], t[i + 3], 0xEE);
+    }
+
+    // gather the 128-bit lanes
+    for (size_t k = 0; k < 4; k++) {
+        __m512 v0 = _mm512_shuffle_f32x4(u[k], u[4 + k], 0x88);
+        __m512 v1 = _mm512_shuffle_f32x4(u[8 + k], u[12 + k], 0x88);
+        __m512 w0 = _mm512_shuffle_f32x4(u[k], u[4 + k], 0xDD);
+        __m512 w1 = _mm512_shuffle_f32x4(u[8 + k], u[12 + k], 0xDD);
+
+        _mm512_storeu_ps(dst + (k) * ldd, _mm512_shuffle_f32x4(v0, v1, 0x88));
+        _mm512_storeu_ps(dst + (k + 4) * ldd, _mm512_shuffle_f32x4(w0, w1, 0x88));
+        _mm512_storeu_ps(dst + (k + 8) * ldd, _mm512_shuffle_f32x4(v0, v1, 0xDD));
+        _mm512_storeu_ps(dst + (k + 12) * ldd, _mm512_shuffle_f32x4(w0, w1, 0xDD));
+    }
+}
+
+#elif defined(__AVX2__)
+
+constexpr size_t KERNEL = 8;
+
+/// 8x8 float transpose in registers
+inline void transpose_kernel(const float* src, size_t lds, float* dst, size_t ldd) {
+    __m256 r[8];
+    for (size_t i = 0; i < 8; i++) {
+        r[i] = _mm256_loadu_ps(src + i * lds);
+    }
+    transpose8x8(r);
+    for (size_t i = 0; i < 8; i++) {
+        _mm256_storeu_ps(dst + i * ldd, r[i]);
+    }
+}
+
+#endif
+
+
+/// transpose of one cache block
+template <typename S, typename D>
+inline void transpose_block(const S* src, size_t lds, D* dst, size_t ldd, size_t rows, size_t cols) {
+    transpose_tile(src, lds, dst, ldd, rows, cols);
+}
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+
+/// cache block as a grid of K x K register kernels (and scalar edges)
+template <size_t K, typename S, typename D, typename Kernel>
+inline void transpose_kernels(const S* src, size_t lds, D* dst, size_t ldd, size_t rows, size_t cols,
+                              Kernel kernel) {
+    // walk the kernels along the rows of dst, so that its cache lines are filled contiguously
+    size_t c = 0;
+    for (; c + K <= cols; c += K) {
+        size_t r = 0;
+        for (; r + K <= rows; r += K) {
+            kernel(src + r * lds + c, lds, dst + c * ldd + r, ldd);
+        }
+        transpose_tile(src + r * lds + c, lds, dst + c * ldd + r, ldd, rows - r, K);
+    }
+    transpose_tile(src + c, lds, dst + c * ldd, ldd, rows, cols - c);
+}
+
+template <>
+inline void transpose_block<float, float>(const float* src, size_t lds, float* dst, size_t ldd,
+                                          size_t rows, size_t cols) {
+    transpose_kernels<KERNEL>(src, lds, dst, ldd, rows, cols,
+                              [](const float* s, size_t ls, float* d, size_t ld) { transpose_kernel(s, ls, d, ld); });
+}
+
+template <>
+inline void transpose_block<double, float>(const double* src, size_t lds, float* dst, size_t ldd,
+                                           size_t rows, size_t cols) {
+    transpose_kernels<8>(src, lds, dst, ldd, rows, cols,
+                         [](const double* s, size_t ls, float* d, size_t ld) { transpose_kernel8(s, ls, d, ld); });
+}
+
+template <>
+inline void transpose_block<float, double>(const float* src, size_t lds, double* dst, size_t ldd,
+                                           size_t rows, size_t cols) {
+    transpose_kernels<8>(src, lds, dst, ldd, rows, cols,
+                         [](const float* s, size_t ls, double* d, size_t ld) { transpose_kernel8(s, ls, d, ld); });
+}
+
+#endif
+
+
+// (shapes and indices are temporaries of the thread arena)
+using Dims = ArenaVector<size_t>;
+
+/// drop the axes of extent 1 (they do not change the element order)
+template <typename It>
+Dims squeeze(It begin, It end) {
+    Dims squeezed;
+    squeezed.reserve(static_cast<size_t>(end - begin));
+    for (; begin != end; ++begin) {
+        if (*begin != 1) {
+            squeezed.push_back(*begin);
+        }
+    }
+    return squeezed;
+}
+
+}  // namespace
+
+
+template <typename S, typename D>
+void convert(const S* src, D* dst, size_t size) {
+    std::copy(src, src + size, dst);
+}
+
+#if defined(__AVX2__)
+
+template <>
+void convert<double, float>(const double* src, float* dst, size_t size) {
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i)));
+    }
+    std::copy(src + i, src + size, dst + i);
+}
+
+template <>
+void convert<float, double>(const float* src, double* dst, size_t size) {
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+    }
+    std::copy(src + i, src + size, dst + i);
+}
+
+#endif
+
+
+template <typename S, typename D>
+void transpose2d(const S* src, size_t lds, D* dst, size_t ldd, size_t rows, size_t cols) {
+    for (size_t r = 0; r < rows; r += BLOCK) {
+        size_t nr = std::min(BLOCK, rows - r);
+        for (size_t c = 0; c < cols; c += BLOCK) {
+            size_t nc = std::min(BLOCK, cols - c);
+            transpose_block(src + r * lds + c, lds, dst + c * ldd + r, ldd, nr, nc);
+        }
+    }
+}
+
+
+namespace {
+
+/// ColMajor src -> RowMajor dst, of squeezed dims
+template <typename S, typename D>
+void toRowMajor(const S* src, D* dst, const Dims& dims) {
+
+    size_t size = 1;
+    for (auto d : dims) {
+        size *= d;
+    }
+    if (size == 0) {
+        return;
+    }
+
+    size_t rank = dims.size();
+
+    // same element order in both layouts
+    if (rank <= 1) {
+        convert(src, dst, size);
+        return;
+    }
+
+    // The first axis is contiguous in src, the last one in dst: for each index
+    // of the middle axes, the (last, first) plane is a 2-D strided transpose.
+    size_t first = dims.front();
+    size_t last  = dims.back();
+    size_t mid   = size / (first * last);
+
+    size_t lds = first * mid;
+    size_t ldd = last * mid;
+
+    // middle axes: ColMajor strides (in units of "first") and current index
+    Dims mid_dims(dims.begin() + 1, dims.end() - 1);
+    Dims mid_strides(mid_dims.size(), 1);
+    for (size_t k = 1; k < mid_dims.size(); k++) {
+        mid_strides[k] = mid_strides[k - 1] * mid_dims[k - 1];
+    }
+    Dims idx(mid_dims.size(), 0);
+
+    // walk the middle axes in RowMajor order
+    size_t src_mid = 0;
+    for (size_t m = 0; m < mid; m++) {
+
+        transpose2d(src + first * src_mid, lds, dst + last * m, ldd, last, first);
+
+        for (size_t k = mid_dims.size(); k-- > 0;) {
+            if (++idx[k] < mid_dims[k]) {
+                src_mid += mid_strides[k];
+                break;
+            }
+            src_mid -= (mid_dims[k] - 1) * mid_strides[k];
+            idx[k] = 0;
+        }
+    }
+}
+
+}  // namespace
+
+
+template <typename S, typename D>
+void colMajorToRowMajor(const S* src, D* dst, const std::vector<size_t>& shape) {
+    Arena::Scope scope;
+    toRowMajor(src, dst, squeeze(shape.begin(), shape.end()));
+}
+
+
+template <typename S, typename D>
+void rowMajorToColMajor(const S* src, D* dst, const std::vector<size_t>& shape) {
+
+    // RowMajor with shape (d0, .., dn) has the same element order as ColMajor with (dn, .., d0)
+    Arena::Scope scope;
+    toRowMajor(src, dst, squeeze(shape.rbegin(), shape.rend()));
+}
+
+
+template void convert<float, float>(const float*, float*, size_t);
+template void transpose2d<float, float>(const float*, size_t, float*, size_t, size_t, size_t);
+template void colMajorToRowMajor<float, float>(const float*, float*, const std::vector<size_t>&);
+template void rowMajorToColMajor<float, float>(const float*, float*, const std::vector<size_t>&);
+
+// double precision callers (converted on the fly)
+template void convert<double, float>(const double*, float*, size_t);
+template void convert<float, double>(const float*, double*, size_t);
+template void colMajorToRowMajor<double, float>(const double*, float*, const std::vector<size_t>&);
+template void rowMajorToColMajor<float, double>(const float*, double*, const std::vector<size_t>&);
+
+}  // namespace layout
+}  // namespace infero
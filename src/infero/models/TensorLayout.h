@@ -0,0 +1,46 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+
+namespace infero {
+namespace layout {
+
+/// Tensor layout conversions (ColMajor <-> RowMajor) of N-d tensors
+///
+/// Both functions take the logical shape of the tensor and write the
+/// reordered data straight into dst (which must not alias src). The
+/// conversion is done as a sequence of cache-blocked 2-D tile transposes,
+/// vectorised with AVX2 / AVX-512 register kernels when the build enables them
+/// (INFERO_SIMD=avx2|avx512|native).
+/// The double <-> float variants convert within the same pass.
+
+/// element-wise copy with type conversion (same layout)
+template <typename S, typename D>
+void convert(const S* src, D* dst, size_t size);
+
+/// ColMajor src -> RowMajor dst
+template <typename S, typename D>
+void colMajorToRowMajor(const S* src, D* dst, const std::vector<size_t>& shape);
+
+/// RowMajor src -> ColMajor dst
+template <typename S, typename D>
+void rowMajorToColMajor(const S* src, D* dst, const std::vector<size_t>& shape);
+
+/// 2-D strided transpose: dst[c * ldd + r] = src[r * lds + c], for r < rows, c < cols
+template <typename S, typename D>
+void transpose2d(const S* src, size_t lds, D* dst, size_t ldd, size_t rows, size_t cols);
+
+}  // namespace layout
+}  // namespace infero
@@ -0,0 +1,309 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "infero/models/InferenceExecutor.h"
+#include "infero/models/TiledInference.h"
+
+
+namespace infero {
+
+namespace {
+
+// position of a tile in the input
+struct Tile {
+    size_t n;
+    size_t y0;
+    size_t x0;
+};
+
+// element strides of the N, H, W and C axes of a [N, H, W, C] tensor
+struct Strides {
+    size_t n;
+    size_t y;
+    size_t x;
+    size_t c;
+};
+
+Strides strides(const eckit::linalg::TensorFloat& t) {
+    const std::vector<size_t>& shape = t.shape();
+    if (t.layout() == eckit::linalg::TensorFloat::Layout::ColMajor) {
+        return {1, shape[0], shape[0] * shape[1], shape[0] * shape[1] * shape[2]};
+    }
+    return {shape[1] * shape[2] * shape[3], shape[2] * shape[3], shape[3], 1};
+}
+
+// (crop) weight of the discarded edges, still used where no other tile covers the field
+constexpr float EDGE_WEIGHT = 1e-6f;
+
+// rows of the output accumulated under the same lock
+constexpr size_t BAND_ROWS = 8;
+
+}  // namespace
+
+
+TiledInference::TiledInference(size_t tileH, size_t tileW, size_t overlap, Blend blend, size_t tileBatch) :
+    tileH_{tileH}, tileW_{tileW}, overlap_{overlap}, blend_{blend}, tileBatch_{tileBatch} {
+
+    ASSERT(tileH_ > 0 && tileW_ > 0 && tileBatch_ > 0);
+    if (overlap_ >= std::min(tileH_, tileW_)) {
+        throw eckit::BadValue("Tile overlap must be smaller than the tile size", Here());
+    }
+}
+
+TiledInference::Blend TiledInference::blend(const std::string& name) {
+    if (name == "average") {
+        return Blend::Average;
+    }
+    if (name == "linear") {
+        return Blend::Linear;
+    }
+    if (name == "crop") {
+        return Blend::Crop;
+    }
+    throw eckit::BadValue("tileBlend must be one of average|linear|crop, found " + name, Here());
+}
+
+std::vector<size_t> TiledInference::tileStarts(size_t extent, size_t tile) const {
+
+    if (extent <= tile) {
+        return {0};
+    }
+
+    std::vector<size_t> starts;
+    for (size_t p = 0; p + tile < extent; p += tile - overlap_) {
+        starts.push_back(p);
+    }
+    starts.push_back(extent - tile);
+    return starts;
+}
+
+float TiledInference::weight(size_t i, size_t tile) const {
+
+    // distance to the nearest edge of the tile
+    size_t d = std::min(i, tile - 1 - i);
+
+    switch (blend_) {
+        case Blend::Linear:
+            return std::min(1.f, static_cast<float>(d + 1) / static_cast<float>(overlap_ + 1));
+        case Blend::Crop:
+            return d >= overlap_ / 2 ? 1.f : EDGE_WEIGHT;
+        default:
+            return 1.f;
+    }
+}
+
+void TiledInference::infer(const eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut, const Run& run,
+                           size_t concurrency, InferenceExecutor* executor) const {
+
+    const std::vector<size_t>& inShape  = tIn.shape();
+    const std::vector<size_t>& outShape = tOut.shape();
+
+    if (inShape.size() != 4 || outShape.size() != 4 ||
+        !std::equal(inShape.begin(), inShape.begin() + 3, outShape.begin())) {
+        throw eckit::BadValue("Tiled inference needs [N, H, W, C] input and output tensors of the same N, H, W",
+                              Here());
+    }
+
+    size_t N  = inShape[0];
+    size_t H  = inShape[1];
+    size_t W  = inShape[2];
+    size_t C  = inShape[3];
+    size_t Co = outShape[3];
+
+    // tiles are cut from, and stitched into, the fields in place (strided if ColMajor)
+    const float* src = tIn.data();
+    float* dst       = tOut.data();
+    Strides in       = strides(tIn);
+    Strides out      = strides(tOut);
+
+    std::fill(dst, dst + tOut.size(), 0.f);
+    std::vector<float> weightSum(N * H * W, 0.f);
+
+    std::vector<Tile> tiles;
+    for (size_t n = 0; n < N; n++) {
+        for (size_t y0 : tileStarts(H, tileH_)) {
+            for (size_t x0 : tileStarts(W, tileW_)) {
+                tiles.push_back({n, y0, x0});
+            }
+        }
+    }
+    size_t nBatches = (tiles.size() + tileBatch_ - 1) / tileBatch_;
+
+    std::vector<float> wy(tileH_);
+    std::vector<float> wx(tileW_);
+    for (size_t i = 0; i < tileH_; i++) {
+        wy[i] = weight(i, tileH_);
+    }
+    for (size_t i = 0; i < tileW_; i++) {
+        wx[i] = weight(i, tileW_);
+    }
+
+    // tiles overlapping the same band of rows are accumulated one at a time
+    size_t nBands = (H + BAND_ROWS - 1) / BAND_ROWS;
+    std::vector<std::mutex> bands(N * nBands);
+
+    std::atomic<size_t> next{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    // each worker takes the next batch of tiles, until none is left (or one has failed)
+    auto worker = [&]() {
+        std::vector<float> bufIn(tileBatch_ * tileH_ * tileW_ * C);
+        std::vector<float> bufOut(tileBatch_ * tileH_ * tileW_ * Co);
+
+        try {
+            for (size_t b = next++; b < nBatches; b = next++) {
+
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (error) {
+                        return;
+                    }
+                }
+
+                size_t t0 = b * tileBatch_;
+                size_t nb = std::min(tileBatch_, tiles.size() - t0);
+
+                // gather (zero padded beyond the field)
+                for (size_t k = 0; k < nb; k++) {
+                    const Tile& tile = tiles[t0 + k];
+                    size_t nx        = std::min(tileW_, W - tile.x0);
+                    for (size_t ty = 0; ty < tileH_; ty++) {
+                        float* row = &bufIn[(k * tileH_ + ty) * tileW_ * C];
+                        size_t y   = tile.y0 + ty;
+                        if (y >= H) {
+                            std::fill(row, row + tileW_ * C, 0.f);
+                            continue;
+                        }
+                        const float* s = src + tile.n * in.n + y * in.y + tile.x0 * in.x;
+                        if (in.c == 1) {
+                            std::memcpy(row, s, nx * C * sizeof(float));
+                        }
+                        else {
+                            for (size_t tx = 0; tx < nx; tx++) {
+                                for (size_t c = 0; c < C; c++) {
+                                    row[tx * C + c] = s[tx * in.x + c * in.c];
+                                }
+                            }
+                        }
+                        std::fill(row + nx * C, row + tileW_ * C, 0.f);
+                    }
+                }
+
+                eckit::linalg::TensorFloat batchIn(bufIn.data(), {nb, tileH_, tileW_, C},
+                                                   eckit::linalg::TensorFloat::Layout::RowMajor);
+                eckit::linalg::TensorFloat batchOut(bufOut.data(), {nb, tileH_, tileW_, Co},
+                                                    eckit::linalg::TensorFloat::Layout::RowMajor);
+                run(batchIn, batchOut);
+
+                // weighted accumulation into the field, a band of rows at a time
+                // (bands taken in increasing order, one at a time)
+                for (size_t k = 0; k < nb; k++) {
+                    const Tile& tile = tiles[t0 + k];
+                    size_t yEnd      = std::min(tile.y0 + tileH_, H);
+                    size_t xEnd      = std::min(tile.x0 + tileW_, W);
+                    for (size_t y0 = tile.y0; y0 < yEnd;) {
+                        size_t y1 = std::min(yEnd, (y0 / BAND_ROWS + 1) * BAND_ROWS);
+                        std::lock_guard<std::mutex> lock(bands[tile.n * nBands + y0 / BAND_ROWS]);
+                        for (size_t y = y0; y < y1; y++) {
+                            size_t ty = y - tile.y0;
+                            for (size_t x = tile.x0; x < xEnd; x++) {
+                                size_t tx      = x - tile.x0;
+                                float w        = wy[ty] * wx[tx];
+                                const float* o = &bufOut[((k * tileH_ + ty) * tileW_ + tx) * Co];
+                                float* d       = dst + tile.n * out.n + y * out.y + x * out.x;
+                                for (size_t c = 0; c < Co; c++) {
+                                    d[c * out.c] += w * o[c];
+                                }
+                                weightSum[(tile.n * H + y) * W + x] += w;
+                            }
+                        }
+                        y0 = y1;
+                    }
+                }
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    // (the calling thread is one of the workers, the others are tasks of the executor)
+    size_t nHelpers = executor ? std::min(std::max<size_t>(concurrency, 1), nBatches) - 1 : 0;
+    if (nHelpers > 0) {
+
+        // helpers starting after the calling thread has finished all the batches (e.g. queued
+        // behind it on a busy executor) do nothing, so only the started ones are waited for
+        struct Helpers {
+            std::mutex mutex;
+            std::condition_variable done;
+            size_t running = 0;
+            bool closed    = false;
+        };
+        auto helpers = std::make_shared<Helpers>();
+
+        for (size_t i = 0; i < nHelpers; i++) {
+            executor->submit([helpers, &worker] {
+                {
+                    std::lock_guard<std::mutex> lock(helpers->mutex);
+                    if (helpers->closed) {
+                        return;
+                    }
+                    helpers->running++;
+                }
+                worker();
+                std::lock_guard<std::mutex> lock(helpers->mutex);
+                if (--helpers->running == 0) {
+                    helpers->done.notify_all();
+                }
+            });
+        }
+
+        worker();
+
+        std::unique_lock<std::mutex> lock(helpers->mutex);
+        helpers->closed = true;
+        helpers->done.wait(lock, [&helpers] { return helpers->running == 0; });
+    }
+    else {
+        worker();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    for (size_t n = 0; n < N; n++) {
+        for (size_t y = 0; y < H; y++) {
+            for (size_t x = 0; x < W; x++) {
+                float inv = 1.f / weightSum[(n * H + y) * W + x];
+                float* d  = dst + n * out.n + y * out.y + x * out.x;
+                for (size_t c = 0; c < Co; c++) {
+                    d[c * out.c] *= inv;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace infero
@@ -0,0 +1,80 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "eckit/linalg/Tensor.h"
+
+
+namespace infero {
+
+class InferenceExecutor;
+
+/// Sliding-window inference of fields larger than the model input.
+///
+/// A [N, H, W, C] (NHWC) input is split into tiles of tileH x tileW pixels,
+/// neighbouring tiles sharing "overlap" pixels (the last tile of a row or
+/// column is aligned to the field edge, fields smaller than a tile are zero
+/// padded). Tiles are run by batches of up to tileBatch, on up to
+/// "concurrency" concurrent engine calls (the calling thread and tasks of the
+/// executor, if any), and their [b, tileH, tileW, Co]
+/// outputs are stitched into the [N, H, W, Co] output, as the weighted mean
+/// of the overlapping tiles:
+///  - average: uniform weights
+///  - linear:  weights ramping up over the overlap from the tile edges (feathering)
+///  - crop:    each tile only contributes away from its edges (halo discarded)
+///
+/// Tiles are gathered from, and stitched into, the tensors in place (strided
+/// if ColMajor): memory stays bounded by the tile batches in flight (plus one
+/// weight per output pixel). Concurrent batches only serialise where their
+/// tiles share a band of output rows.
+class TiledInference {
+
+public:
+
+    enum class Blend
+    {
+        Average,
+        Linear,
+        Crop
+    };
+
+    /// runs one batch of tiles ([b, tileH, tileW, C] -> [b, tileH, tileW, Co])
+    using Run = std::function<void(eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut)>;
+
+    TiledInference(size_t tileH, size_t tileW, size_t overlap, Blend blend, size_t tileBatch);
+
+    /// blend mode from its name: average|linear|crop
+    static Blend blend(const std::string& name);
+
+    /// tIn: [N, H, W, C], tOut: [N, H, W, Co] (either layout)
+    void infer(const eckit::linalg::TensorFloat& tIn, eckit::linalg::TensorFloat& tOut, const Run& run,
+               size_t concurrency, InferenceExecutor* executor = nullptr) const;
+
+    /// first row/column of each tile along an axis of the field
+    std::vector<size_t> tileStarts(size_t extent, size_t tile) const;
+
+    /// blending weight of the i-th row/column of a tile
+    float weight(size_t i, size_t tile) const;
+
+private:
+
+    size_t tileH_;
+    size_t tileW_;
+    size_t overlap_;
+    Blend blend_;
+    size_t tileBatch_;
+};
+
+}  // namespace infero
@@ -0,0 +1,81 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#pragma once
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "cnpy/cnpy.h"
+
+#include "eckit/config/LocalConfiguration.h"
+
+
+namespace test {
+
+/// deterministic values in [-0.5, 0.5)
+inline std::vector<float> values(size_t n, size_t seed) {
+    std::vector<float> v(n);
+    for (size_t i = 0; i < n; i++) {
+        v[i] = static_cast<float>((i * 7919 + seed * 104729) % 1000) / 1000.f - 0.5f;
+    }
+    return v;
+}
+
+/// Two dense layers (inputs -> hidden -> outputs) saved as a native_mlp npz
+/// file, named after the test and the process, removed with the fixture
+struct TwoLayerMLP {
+
+    TwoLayerMLP(const std::string& name, size_t inputs, size_t hidden, size_t outputs, size_t seed) :
+        inputs{inputs},
+        hidden{hidden},
+        outputs{outputs},
+        kernel0{values(inputs * hidden, seed)},
+        bias0{values(hidden, seed + 1)},
+        kernel1{values(hidden * outputs, seed + 2)},
+        bias1{values(outputs, seed + 3)},
+        path{name + "." + std::to_string(::getpid()) + ".npz"} {
+
+        cnpy::npz_save(path, "kernel_0", kernel0.data(), {inputs, hidden}, "w");
+        cnpy::npz_save(path, "bias_0", bias0.data(), {hidden}, "a");
+        cnpy::npz_save(path, "kernel_1", kernel1.data(), {hidden, outputs}, "a");
+        cnpy::npz_save(path, "bias_1", bias1.data(), {outputs}, "a");
+    }
+
+    ~TwoLayerMLP() { std::remove(path.c_str()); }
+
+    TwoLayerMLP(const TwoLayerMLP&)            = delete;
+    TwoLayerMLP& operator=(const TwoLayerMLP&) = delete;
+
+    /// configuration of a native_mlp model of this file
+    eckit::LocalConfiguration config(const eckit::LocalConfiguration& model_config = {}) const {
+        eckit::LocalConfiguration local;
+        local.set("path", path);
+        local.set("type", std::string{"native_mlp"});
+        local.set("model_config", model_config);
+        return local;
+    }
+
+    size_t inputs;
+    size_t hidden;
+    size_t outputs;
+
+    std::vector<float> kernel0;
+    std::vector<float> bias0;
+    std::vector<float> kernel1;
+    std::vector<float> bias1;
+
+    std::string path;
+};
+
+}  // namespace test
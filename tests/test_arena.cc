@@ -0,0 +1,164 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "eckit/linalg/Tensor.h"
+#include "eckit/testing/Test.h"
+
+#include "infero/models/Arena.h"
+#include "infero/models/InferenceModel.h"
+
+#include "MLPFixture.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+using eckit::linalg::TensorFloat;
+
+
+// counts the heap allocations of the whole test
+static std::atomic<size_t> heapAllocations{0};
+
+void* operator new(size_t size) {
+    heapAllocations++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+
+namespace test {
+
+namespace {
+
+bool aligned(const void* p, size_t alignment) {
+    return reinterpret_cast<uintptr_t>(p) % alignment == 0;
+}
+
+}  // namespace
+
+
+CASE("Allocations are aligned, and fit in the block once it has grown") {
+
+    Arena arena;
+
+    auto pass = [&arena] {
+        EXPECT(aligned(arena.allocate(3, 1), 1));
+        EXPECT(aligned(arena.allocate(100, 64), 64));
+        EXPECT(aligned(arena.allocate(8, 8), 8));
+        EXPECT(aligned(arena.allocate(1000), alignof(std::max_align_t)));
+    };
+
+    pass();
+    arena.reset();
+    EXPECT(arena.used() == 0);
+
+    size_t capacity = arena.capacity();
+    EXPECT(capacity >= 3 + 100 + 8 + 1000);
+
+    // the same allocations now come from the block
+    for (int i = 0; i < 3; i++) {
+        pass();
+        EXPECT(arena.used() > 0);
+        arena.reset();
+        EXPECT(arena.capacity() == capacity);
+    }
+}
+
+
+CASE("ArenaVectors draw from the thread arena, released by the outermost scope") {
+
+    // warm up the arena of this thread
+    {
+        Arena::Scope scope;
+        ArenaVector<int64_t> v(1000, 1);
+    }
+
+    {
+        Arena::Scope outer;
+        {
+            Arena::Scope inner;
+
+            ArenaVector<int64_t> v;
+            for (int64_t i = 0; i < 100; i++) {
+                v.push_back(i);
+            }
+            EXPECT(v[99] == 99);
+            EXPECT(v.get_allocator().arena() == &Arena::thread());
+        }
+
+        // (the temporaries of the inner scope belong to the outer one)
+        EXPECT(Arena::thread().used() > 0);
+    }
+
+    EXPECT(Arena::thread().used() == 0);
+}
+
+
+CASE("Steady-state inference does not allocate") {
+
+    size_t batch = 16, inputs = 8, hidden = 32, outputs = 4;
+    TwoLayerMLP net("infero_test_arena", inputs, hidden, outputs, 1);
+
+    std::unique_ptr<InferenceModel> model(InferenceModelFactory::instance().build("native_mlp", net.config()));
+
+    std::vector<float> x = values(batch * inputs, 5);
+    TensorFloat tIn(x.data(), {batch, inputs});
+    TensorFloat tOut({batch, outputs});
+
+    // ColMajor tensors go through the layout buffers of the session
+    TensorFloat tInCol(x.data(), {batch, inputs}, TensorFloat::Layout::ColMajor);
+    TensorFloat tOutCol({batch, outputs}, TensorFloat::Layout::ColMajor);
+
+    std::vector<TensorFloat*> mimoIn{&tIn};
+    std::vector<TensorFloat*> mimoOut{&tOut};
+    std::vector<const char*> inNames{"input"};
+    std::vector<const char*> outNames{"output"};
+
+    auto calls = [&] {
+        model->infer(tIn, tOut);
+        model->infer(tInCol, tOutCol);
+        model->infer_mimo(mimoIn, inNames, mimoOut, outNames);
+    };
+
+    // warm up (scratch and layout buffers, arena)
+    calls();
+    calls();
+
+    size_t before = heapAllocations.load();
+    for (int i = 0; i < 10; i++) {
+        calls();
+    }
+    size_t allocated = heapAllocations.load() - before;
+
+    EXPECT(allocated == 0);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
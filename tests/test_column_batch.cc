@@ -0,0 +1,149 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <thread>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/linalg/Tensor.h"
+#include "eckit/testing/Test.h"
+
+#include "infero/models/ColumnBatch.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+using eckit::linalg::TensorFloat;
+
+namespace test {
+
+namespace {
+
+constexpr size_t INPUTS  = 5;
+constexpr size_t OUTPUTS = 3;
+
+/// "model": out[r, j] = (j + 1) * sum_k in[r, k]
+void rowSums(TensorFloat& tIn, TensorFloat& tOut) {
+    EXPECT(tIn.layout() == TensorFloat::Layout::RowMajor);
+    size_t rows = tIn.shape()[0];
+    for (size_t r = 0; r < rows; r++) {
+        float sum = 0;
+        for (size_t k = 0; k < INPUTS; k++) {
+            sum += tIn.data()[r * INPUTS + k];
+        }
+        for (size_t j = 0; j < OUTPUTS; j++) {
+            tOut.data()[r * OUTPUTS + j] = (j + 1) * sum;
+        }
+    }
+}
+
+/// a block of columns, ColMajor (as from Fortran) or RowMajor
+struct Block {
+    Block(size_t rows, size_t seed, bool colMajor) :
+        rows(rows), colMajor(colMajor), in(rows * INPUTS), out(rows * OUTPUTS, -1.f) {
+        for (size_t r = 0; r < rows; r++) {
+            for (size_t k = 0; k < INPUTS; k++) {
+                in[index(r, k, INPUTS)] = static_cast<float>(seed * 100 + r) + 0.1f * k;
+            }
+        }
+    }
+
+    size_t index(size_t r, size_t c, size_t cols) const { return colMajor ? c * rows + r : r * cols + c; }
+
+    bool check() const {
+        for (size_t r = 0; r < rows; r++) {
+            float sum = 0;
+            for (size_t k = 0; k < INPUTS; k++) {
+                sum += in[index(r, k, INPUTS)];
+            }
+            for (size_t j = 0; j < OUTPUTS; j++) {
+                if (out[index(r, j, OUTPUTS)] != (j + 1) * sum) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    TensorFloat::Layout layout() const { return colMajor ? TensorFloat::Layout::ColMajor : TensorFloat::Layout::RowMajor; }
+
+    size_t rows;
+    bool colMajor;
+    std::vector<float> in;
+    std::vector<float> out;
+};
+
+}  // namespace
+
+
+CASE("Blocks added by several threads are run as one batch") {
+
+    ColumnBatch batch;
+
+    std::vector<Block> blocks;
+    for (size_t i = 0; i < 16; i++) {
+        blocks.emplace_back(i % 3 == 0 ? 7 : 16, i, i % 2 == 0);
+    }
+
+    for (size_t step = 0; step < 2; step++) {
+
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 4; t++) {
+            threads.emplace_back([&batch, &blocks, t] {
+                for (size_t i = t; i < blocks.size(); i += 4) {
+                    Block& b = blocks[i];
+                    batch.add(b.rows, INPUTS, b.in.data(), OUTPUTS, b.out.data(), b.layout());
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        EXPECT(batch.blocks() == blocks.size());
+
+        size_t runs = 0;
+        batch.run([&runs](TensorFloat& tIn, TensorFloat& tOut) {
+            runs++;
+            rowSums(tIn, tOut);
+        });
+        EXPECT(runs == 1);
+
+        for (const auto& b : blocks) {
+            EXPECT(b.check());
+        }
+
+        // ready for the next time step
+        EXPECT(batch.blocks() == 0);
+        EXPECT(batch.rows() == 0);
+    }
+}
+
+
+CASE("Blocks of a batch must have the same features") {
+
+    ColumnBatch batch;
+
+    Block b(4, 0, true);
+    batch.add(b.rows, INPUTS, b.in.data(), OUTPUTS, b.out.data(), b.layout());
+    EXPECT_THROWS_AS(batch.add(b.rows, INPUTS - 1, b.in.data(), OUTPUTS, b.out.data(), b.layout()), eckit::BadValue);
+
+    // a failed run starts over too
+    EXPECT_THROWS_AS(batch.run([](TensorFloat&, TensorFloat&) { throw eckit::SeriousBug("engine failure", Here()); }),
+                     eckit::SeriousBug);
+    EXPECT(batch.blocks() == 0);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
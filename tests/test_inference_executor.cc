@@ -0,0 +1,80 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/testing/Test.h"
+
+#include "infero/models/InferenceExecutor.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+namespace test {
+
+
+CASE("Tasks run in the background and complete their futures") {
+
+    InferenceExecutor executor(3);
+    EXPECT(executor.size() == 3);
+
+    std::atomic<size_t> count{0};
+    std::vector<std::future<void>> futures;
+    for (size_t i = 0; i < 100; i++) {
+        futures.push_back(executor.submit([&count] { count++; }));
+    }
+
+    for (auto& f : futures) {
+        f.get();
+    }
+    EXPECT(count == 100);
+}
+
+
+CASE("Task errors are rethrown by the future") {
+
+    InferenceExecutor executor(1);
+
+    auto f = executor.submit([] { throw eckit::SeriousBug("task failure", Here()); });
+    EXPECT_THROWS_AS(f.get(), eckit::SeriousBug);
+
+    // the worker survives
+    auto g = executor.submit([] {});
+    g.get();
+}
+
+
+CASE("Drain waits for all the tasks") {
+
+    InferenceExecutor executor(2);
+
+    std::atomic<size_t> count{0};
+    for (size_t i = 0; i < 20; i++) {
+        executor.submit([&count] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            count++;
+        });
+    }
+
+    executor.drain();
+    EXPECT(count == 20);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
@@ -0,0 +1,95 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/testing/Test.h"
+
+#include "infero/models/ModelBuffer.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+namespace fs = std::filesystem;
+
+namespace test {
+
+namespace {
+
+std::string scratch(const std::string& name) {
+    return (fs::temp_directory_path() / (name + "." + std::to_string(::getpid()))).string();
+}
+
+/// file of size bytes (not a multiple of the page size), removed on scope exit
+struct ScratchFile {
+
+    ScratchFile(const std::string& name, size_t size) : path{scratch(name)}, bytes(size) {
+        for (size_t i = 0; i < size; i++) {
+            bytes[i] = static_cast<char>((i * 31 + 7) % 251);
+        }
+        std::ofstream out(path, std::ios::binary);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    ~ScratchFile() { fs::remove(path); }
+
+    std::string path;
+    std::vector<char> bytes;
+};
+
+bool same(const ModelBuffer& buffer, const ScratchFile& file) {
+    return buffer.size() == file.bytes.size() && std::memcmp(buffer.data(), file.bytes.data(), buffer.size()) == 0;
+}
+
+}  // namespace
+
+
+CASE("Mapped files hold the bytes of the file, with and without populate") {
+
+    ScratchFile file("infero_test_model_buffer", 3 * 4096 + 123);
+
+    EXPECT(same(ModelBuffer::mapped(file.path), file));
+    EXPECT(same(ModelBuffer::mapped(file.path, true), file));
+
+    for (auto advice : {ModelBuffer::Advice::Sequential, ModelBuffer::Advice::Random, ModelBuffer::Advice::WillNeed}) {
+        EXPECT(same(ModelBuffer::mapped(file.path, false, advice), file));
+    }
+
+    // (the mapping outlives the buffer it is moved from)
+    ModelBuffer buffer;
+    {
+        ModelBuffer tmp = ModelBuffer::mapped(file.path, true);
+        buffer          = std::move(tmp);
+    }
+    EXPECT(same(buffer, file));
+}
+
+
+CASE("Missing and empty files are not mapped") {
+
+    EXPECT_THROWS_AS(ModelBuffer::mapped(scratch("infero_test_model_buffer_missing")), eckit::CantOpenFile);
+
+    ScratchFile empty("infero_test_model_buffer_empty", 0);
+    EXPECT_THROWS_AS(ModelBuffer::mapped(empty.path), eckit::BadValue);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
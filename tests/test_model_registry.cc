@@ -0,0 +1,77 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <memory>
+#include <string>
+
+#include "eckit/testing/Test.h"
+
+#include "infero/models/ModelRegistry.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+namespace test {
+
+namespace {
+
+struct Weights {
+    std::string path;
+};
+
+}  // namespace
+
+
+CASE("Models with the same key share one load") {
+
+    ModelRegistry& registry = ModelRegistry::instance();
+
+    size_t loads = 0;
+    auto load = [&loads]() {
+        loads++;
+        return std::make_shared<Weights>(Weights{"model-a"});
+    };
+
+    size_t hits = registry.hits();
+
+    std::shared_ptr<Weights> a1 = registry.get<Weights>("onnx\nmodel-a", load);
+    std::shared_ptr<Weights> a2 = registry.get<Weights>("onnx\nmodel-a", load);
+    std::shared_ptr<Weights> b  = registry.get<Weights>("onnx\nmodel-b", load);
+
+    EXPECT(a1 == a2);
+    EXPECT(a1 != b);
+    EXPECT(loads == 2);
+    EXPECT(registry.hits() == hits + 1);
+}
+
+
+CASE("Models are loaded again once released") {
+
+    ModelRegistry& registry = ModelRegistry::instance();
+
+    size_t loads = 0;
+    auto load = [&loads]() {
+        loads++;
+        return std::make_shared<Weights>(Weights{"model-c"});
+    };
+
+    std::weak_ptr<Weights> first = registry.get<Weights>("tflite\nmodel-c", load);
+    EXPECT(first.expired());
+
+    std::shared_ptr<Weights> second = registry.get<Weights>("tflite\nmodel-c", load);
+    EXPECT(loads == 2);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
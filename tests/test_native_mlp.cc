@@ -0,0 +1,294 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cnpy/cnpy.h"
+
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/linalg/Tensor.h"
+#include "eckit/testing/Test.h"
+
+#include "infero/models/DenseKernels.h"
+#include "infero/models/InferenceModel.h"
+#include "infero/models/ModelRegistry.h"
+
+#include "MLPFixture.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+namespace test {
+
+namespace {
+
+float activate(float v, mlp::Activation act) {
+    switch (act) {
+        case mlp::Activation::Relu:
+            return std::max(v, 0.f);
+        case mlp::Activation::Tanh:
+            return std::tanh(v);
+        case mlp::Activation::Sigmoid:
+            return 1.f / (1.f + std::exp(-v));
+        default:
+            return v;
+    }
+}
+
+/// naive y = act(x * kernel + bias)
+std::vector<float> reference(const std::vector<float>& x, size_t batch, const std::vector<float>& kernel,
+                             const std::vector<float>& bias, size_t inputs, size_t outputs, mlp::Activation act) {
+    std::vector<float> y(batch * outputs);
+    for (size_t r = 0; r < batch; r++) {
+        for (size_t c = 0; c < outputs; c++) {
+            double sum = bias[c];
+            for (size_t k = 0; k < inputs; k++) {
+                sum += double(x[r * inputs + k]) * kernel[k * outputs + c];
+            }
+            y[r * outputs + c] = activate(static_cast<float>(sum), act);
+        }
+    }
+    return y;
+}
+
+bool close(const float* a, const float* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (std::abs(a[i] - b[i]) > 1e-4f * (1.f + std::abs(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+
+CASE("Dense layers match the naive product, for all tile remainders") {
+
+    // (batch, inputs, outputs): partial row tiles, panels and input blocks
+    std::vector<std::vector<size_t>> sizes{{1, 5, 3}, {4, 16, 16}, {7, 300, 19}, {13, 17, 33}, {32, 513, 40}};
+
+    for (const auto& s : sizes) {
+        size_t batch = s[0], inputs = s[1], outputs = s[2];
+
+        std::vector<float> x      = values(batch * inputs, 1);
+        std::vector<float> kernel = values(inputs * outputs, 2);
+        std::vector<float> bias   = values(outputs, 3);
+
+        for (auto act : {mlp::Activation::Linear, mlp::Activation::Relu, mlp::Activation::Tanh,
+                         mlp::Activation::Sigmoid}) {
+
+            mlp::DenseLayer layer(kernel.data(), bias.data(), inputs, outputs, act);
+
+            std::vector<float> y(batch * outputs);
+            layer.apply(x.data(), batch, y.data());
+
+            std::vector<float> ref = reference(x, batch, kernel, bias, inputs, outputs, act);
+            EXPECT(close(y.data(), ref.data(), y.size()));
+        }
+    }
+}
+
+
+CASE("Unknown activations are rejected") {
+    EXPECT(mlp::activation("relu") == mlp::Activation::Relu);
+    EXPECT_THROWS_AS(mlp::activation("softplus"), eckit::BadValue);
+}
+
+
+CASE("native_mlp model runs a two-layer network from npz") {
+
+    size_t batch = 9, inputs = 6, hidden = 20, outputs = 3;
+    TwoLayerMLP net("infero_test_native_mlp", inputs, hidden, outputs, 4);
+
+    eckit::LocalConfiguration model_config;
+    model_config.set("activations", std::string{"tanh"});
+
+    std::unique_ptr<InferenceModel> model(
+        InferenceModelFactory::instance().build("native_mlp", net.config(model_config)));
+
+    std::vector<float> x = values(batch * inputs, 8);
+    eckit::linalg::TensorFloat tIn(x.data(), {batch, inputs});
+
+    std::vector<float> h   = reference(x, batch, net.kernel0, net.bias0, inputs, hidden, mlp::Activation::Tanh);
+    std::vector<float> ref = reference(h, batch, net.kernel1, net.bias1, hidden, outputs, mlp::Activation::Linear);
+
+    eckit::linalg::TensorFloat tOut({batch, outputs});
+    model->infer(tIn, tOut);
+    EXPECT(close(tOut.data(), ref.data(), ref.size()));
+
+    // ColMajor output
+    eckit::linalg::TensorFloat tOutCol({batch, outputs}, eckit::linalg::TensorFloat::Layout::ColMajor);
+    model->infer(tIn, tOutCol);
+    for (size_t r = 0; r < batch; r++) {
+        for (size_t c = 0; c < outputs; c++) {
+            EXPECT(std::abs(tOutCol.data()[c * batch + r] - ref[r * outputs + c]) < 1e-4f);
+        }
+    }
+
+    // (features, batch) ColMajor arrays, passed through as they are
+    model_config.set("layoutReinterpret", std::string{"1"});
+    std::unique_ptr<InferenceModel> reinterpreting(
+        InferenceModelFactory::instance().build("native_mlp", net.config(model_config)));
+
+    eckit::linalg::TensorFloat tInFeat(x.data(), {inputs, batch}, eckit::linalg::TensorFloat::Layout::ColMajor);
+    eckit::linalg::TensorFloat tOutFeat({outputs, batch}, eckit::linalg::TensorFloat::Layout::ColMajor);
+    reinterpreting->infer(tInFeat, tOutFeat);
+    EXPECT(close(tOutFeat.data(), ref.data(), ref.size()));
+}
+
+
+CASE("A single layer model is linear with the default activations") {
+
+    size_t batch = 5, inputs = 4, outputs = 3;
+
+    std::vector<float> kernel = values(inputs * outputs, 1);
+    std::vector<float> bias   = values(outputs, 2);
+
+    std::string path = "infero_test_native_mlp_linear." + std::to_string(::getpid()) + ".npz";
+    cnpy::npz_save(path, "kernel_0", kernel.data(), {inputs, outputs}, "w");
+    cnpy::npz_save(path, "bias_0", bias.data(), {outputs}, "a");
+
+    eckit::LocalConfiguration local;
+    local.set("path", path);
+    local.set("type", std::string{"native_mlp"});
+
+    std::unique_ptr<InferenceModel> model(InferenceModelFactory::instance().build("native_mlp", local));
+
+    std::vector<float> x = values(batch * inputs, 3);
+    eckit::linalg::TensorFloat tIn(x.data(), {batch, inputs});
+    eckit::linalg::TensorFloat tOut({batch, outputs});
+    model->infer(tIn, tOut);
+
+    // (negative outputs are not clipped)
+    std::vector<float> ref = reference(x, batch, kernel, bias, inputs, outputs, mlp::Activation::Linear);
+    EXPECT(std::any_of(ref.begin(), ref.end(), [](float v) { return v < 0.f; }));
+    EXPECT(close(tOut.data(), ref.data(), ref.size()));
+
+    std::remove(path.c_str());
+}
+
+
+CASE("Concurrent calls share the sessions of a model") {
+
+    size_t batch = 16, inputs = 8, hidden = 32, outputs = 4;
+    size_t nThreads = 8, nRequests = 50;
+    TwoLayerMLP net("infero_test_native_mlp_sessions", inputs, hidden, outputs, 2);
+
+    eckit::LocalConfiguration model_config;
+    model_config.set("numSessions", std::string{"4"});
+
+    std::unique_ptr<InferenceModel> model(
+        InferenceModelFactory::instance().build("native_mlp", net.config(model_config)));
+
+    // (different inputs per thread, so that mixed up sessions or outputs show)
+    std::atomic<size_t> errors{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nThreads; t++) {
+        threads.emplace_back([&, t] {
+            std::vector<float> x = values(batch * inputs, 10 + t);
+            std::vector<float> h = reference(x, batch, net.kernel0, net.bias0, inputs, hidden, mlp::Activation::Relu);
+            std::vector<float> ref =
+                reference(h, batch, net.kernel1, net.bias1, hidden, outputs, mlp::Activation::Linear);
+
+            eckit::linalg::TensorFloat tIn(x.data(), {batch, inputs});
+            for (size_t n = 0; n < nRequests; n++) {
+                eckit::linalg::TensorFloat tOut({batch, outputs});
+                model->infer(tIn, tOut);
+                if (!close(tOut.data(), ref.data(), ref.size())) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    EXPECT(errors == 0);
+}
+
+
+CASE("Models differing only in how they run share the loaded weights") {
+
+    TwoLayerMLP net("infero_test_native_mlp_shared", 4, 8, 2, 3);
+
+    ModelRegistry& registry = ModelRegistry::instance();
+
+    std::unique_ptr<InferenceModel> model(InferenceModelFactory::instance().build("native_mlp", net.config()));
+    size_t hits = registry.hits();
+
+    // (both sessions share the load of the first model)
+    eckit::LocalConfiguration running;
+    running.set("numSessions", std::string{"2"});
+    running.set("maxBatchSize", std::string{"8"});
+    running.set("modelBuffer", std::string{"mmap"});
+    std::unique_ptr<InferenceModel> tuned(
+        InferenceModelFactory::instance().build("native_mlp", net.config(running)));
+    EXPECT(registry.hits() == hits + 2);
+
+    // other activations are another model
+    eckit::LocalConfiguration activations;
+    activations.set("activations", std::string{"tanh"});
+    std::unique_ptr<InferenceModel> other(
+        InferenceModelFactory::instance().build("native_mlp", net.config(activations)));
+    EXPECT(registry.hits() == hits + 2);
+}
+
+
+CASE("Queued asynchronous requests complete before the model goes") {
+
+    size_t batch = 64, inputs = 16, hidden = 64, outputs = 8, requests = 32;
+    TwoLayerMLP net("infero_test_native_mlp_async", inputs, hidden, outputs, 1);
+
+    eckit::LocalConfiguration model_config;
+    model_config.set("asyncThreads", std::string{"1"});
+
+    std::vector<float> x = values(batch * inputs, 5);
+    eckit::linalg::TensorFloat tIn(x.data(), {batch, inputs});
+
+    std::vector<float> h   = reference(x, batch, net.kernel0, net.bias0, inputs, hidden, mlp::Activation::Relu);
+    std::vector<float> ref = reference(h, batch, net.kernel1, net.bias1, hidden, outputs, mlp::Activation::Linear);
+
+    std::vector<std::unique_ptr<eckit::linalg::TensorFloat>> tOut;
+    std::vector<std::future<void>> futures;
+    {
+        std::unique_ptr<InferenceModel> model(
+            InferenceModelFactory::instance().build("native_mlp", net.config(model_config)));
+        for (size_t i = 0; i < requests; i++) {
+            tOut.emplace_back(new eckit::linalg::TensorFloat({batch, outputs}));
+            futures.push_back(model->infer_async(tIn, *tOut.back()));
+        }
+
+        // (destroyed with requests still queued)
+    }
+
+    for (size_t i = 0; i < requests; i++) {
+        futures[i].get();
+        EXPECT(close(tOut[i]->data(), ref.data(), ref.size()));
+    }
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
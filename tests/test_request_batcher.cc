@@ -0,0 +1,112 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/testing/Test.h"
+
+#include "infero/models/RequestBatcher.h"
+
+using namespace eckit::testing;
+using eckit::linalg::TensorFloat;
+using namespace infero;
+
+namespace test {
+
+
+CASE("Concurrent requests are coalesced and scattered back") {
+
+    const size_t nThreads  = 8;
+    const size_t nRequests = 200;
+    const size_t cols      = 3;
+
+    RequestBatcher batcher(32, std::chrono::microseconds(500));
+
+    // y = 2 * x, counting the engine runs
+    std::atomic<size_t> runs{0};
+    auto engine = [&runs](RequestBatcher::Tensors& tIn, RequestBatcher::Names&,
+                          RequestBatcher::Tensors& tOut, RequestBatcher::Names&) {
+        runs++;
+        EXPECT(tIn[0]->layout() == TensorFloat::Layout::RowMajor);
+        for (size_t i = 0; i < tIn[0]->size(); i++) {
+            tOut[0]->data()[i] = 2 * tIn[0]->data()[i];
+        }
+    };
+
+    std::atomic<size_t> errors{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nThreads; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t n = 0; n < nRequests; n++) {
+
+                size_t rows = 1 + (n + t) % 4;
+                auto layout = (n % 2) ? TensorFloat::Layout::ColMajor : TensorFloat::Layout::RowMajor;
+
+                std::vector<float> x(rows * cols);
+                std::vector<float> y(rows * cols, -1);
+                for (size_t i = 0; i < x.size(); i++) {
+                    x[i] = static_cast<float>(t * 100000 + n * 100 + i);
+                }
+
+                TensorFloat tx(x.data(), {rows, cols}, layout);
+                TensorFloat ty(y.data(), {rows, cols}, layout);
+
+                RequestBatcher::Tensors tIn{&tx};
+                RequestBatcher::Tensors tOut{&ty};
+                RequestBatcher::Names inNames{"x"};
+                RequestBatcher::Names outNames{"y"};
+                batcher.submit(tIn, inNames, tOut, outNames, engine);
+
+                for (size_t i = 0; i < x.size(); i++) {
+                    if (y[i] != 2 * x[i]) {
+                        errors++;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    EXPECT(errors == 0);
+    EXPECT(runs <= nThreads * nRequests);
+}
+
+
+CASE("Engine errors reach every caller of the batch") {
+
+    RequestBatcher batcher(16, std::chrono::microseconds(100));
+
+    auto engine = [](RequestBatcher::Tensors&, RequestBatcher::Names&, RequestBatcher::Tensors&,
+                     RequestBatcher::Names&) { throw eckit::SeriousBug("engine failure", Here()); };
+
+    std::vector<float> x(4, 1.f);
+    std::vector<float> y(4, 0.f);
+    TensorFloat tx(x.data(), {2, 2}, TensorFloat::Layout::RowMajor);
+    TensorFloat ty(y.data(), {2, 2}, TensorFloat::Layout::RowMajor);
+
+    RequestBatcher::Tensors tIn{&tx};
+    RequestBatcher::Tensors tOut{&ty};
+    RequestBatcher::Names inNames{"x"};
+    RequestBatcher::Names outNames{"y"};
+
+    EXPECT_THROWS_AS(batcher.submit(tIn, inNames, tOut, outNames, engine), eckit::SeriousBug);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
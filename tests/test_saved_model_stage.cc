@@ -0,0 +1,96 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/testing/Test.h"
+
+#include "infero/models/SavedModelStage.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+namespace fs = std::filesystem;
+
+namespace test {
+
+namespace {
+
+std::string scratch(const std::string& name) {
+    return (fs::temp_directory_path() / (name + "." + std::to_string(::getpid()))).string();
+}
+
+void writeFile(const fs::path& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary);
+    out << content;
+}
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+
+CASE("A model directory is recreated from its archive") {
+
+    // layout of a SavedModel
+    fs::path model = scratch("infero-test-model");
+    fs::create_directories(model / "variables");
+    fs::create_directories(model / "assets");
+    writeFile(model / "saved_model.pb", std::string("graph\0def", 9));
+    writeFile(model / "variables" / "variables.index", "index");
+    writeFile(model / "variables" / "variables.data-00000-of-00001", std::string(100000, 'w'));
+
+    std::vector<char> archive = SavedModelStage::pack(model.string());
+
+    fs::path copy = scratch("infero-test-copy");
+    SavedModelStage::unpack(archive.data(), archive.size(), copy.string());
+
+    EXPECT(fs::is_directory(copy / "assets"));
+    EXPECT(readFile(copy / "saved_model.pb") == std::string("graph\0def", 9));
+    EXPECT(readFile(copy / "variables" / "variables.index") == "index");
+    EXPECT(readFile(copy / "variables" / "variables.data-00000-of-00001") == std::string(100000, 'w'));
+
+    fs::remove_all(model);
+    fs::remove_all(copy);
+}
+
+
+CASE("Truncated archives are rejected") {
+
+    fs::path model = scratch("infero-test-model");
+    fs::create_directories(model);
+    writeFile(model / "saved_model.pb", "graph");
+
+    std::vector<char> archive = SavedModelStage::pack(model.string());
+
+    fs::path copy = scratch("infero-test-copy");
+    EXPECT_THROWS_AS(SavedModelStage::unpack(archive.data(), archive.size() - 1, copy.string()), eckit::BadValue);
+    EXPECT_THROWS_AS(SavedModelStage::unpack("garbage", 7, copy.string()), eckit::BadValue);
+
+    fs::remove_all(model);
+    fs::remove_all(copy);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
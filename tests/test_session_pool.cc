@@ -0,0 +1,130 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "eckit/testing/Test.h"
+
+#include "infero/models/SessionPool.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+namespace test {
+
+
+CASE("All the slots are handed out once, then given back") {
+
+    SessionPool pool(4);
+    EXPECT(pool.size() == 4);
+
+    std::set<size_t> slots;
+    for (size_t i = 0; i < pool.size(); i++) {
+        slots.insert(pool.acquire());
+    }
+    EXPECT(slots == std::set<size_t>({0, 1, 2, 3}));
+
+    for (auto slot : slots) {
+        pool.release(slot);
+    }
+
+    // (the pool is full again)
+    std::set<size_t> again;
+    for (size_t i = 0; i < pool.size(); i++) {
+        again.insert(pool.acquire());
+    }
+    EXPECT(again == slots);
+}
+
+
+CASE("Concurrent acquire/release never share a slot") {
+
+    const size_t nSlots      = 3;
+    const size_t nThreads    = 8;
+    const size_t nIterations = 20000;
+
+    SessionPool pool(nSlots);
+
+    // thread owning each slot (-1 if free), and the slots in use
+    std::vector<std::atomic<int>> owner(nSlots);
+    for (auto& o : owner) {
+        o.store(-1);
+    }
+    std::atomic<size_t> inUse{0};
+
+    std::atomic<size_t> errors{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nThreads; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t n = 0; n < nIterations; n++) {
+
+                size_t slot = pool.acquire();
+                if (slot >= nSlots || ++inUse > nSlots) {
+                    errors++;
+                }
+
+                int free = -1;
+                if (!owner[slot].compare_exchange_strong(free, static_cast<int>(t))) {
+                    errors++;
+                }
+
+                // (hold the slot for a while, now and then)
+                if (n % 64 == 0) {
+                    std::this_thread::yield();
+                }
+
+                int self = static_cast<int>(t);
+                if (!owner[slot].compare_exchange_strong(self, -1)) {
+                    errors++;
+                }
+
+                --inUse;
+                pool.release(slot);
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    EXPECT(errors == 0);
+    EXPECT(inUse == 0);
+}
+
+
+CASE("An exhausted pool blocks until a slot is released") {
+
+    SessionPool pool(1);
+    size_t slot = pool.acquire();
+
+    std::atomic<bool> acquired{false};
+    std::thread waiter([&] {
+        pool.release(pool.acquire());
+        acquired = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT(!acquired);
+
+    pool.release(slot);
+    waiter.join();
+    EXPECT(acquired);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
@@ -0,0 +1,157 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <vector>
+
+#include "eckit/testing/Test.h"
+
+#include "infero/models/TensorLayout.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+namespace test {
+
+namespace {
+
+/// reference ColMajor -> RowMajor, one element at a time
+std::vector<float> naiveColMajorToRowMajor(const std::vector<float>& src, const std::vector<size_t>& shape) {
+
+    size_t rank = shape.size();
+    std::vector<float> dst(src.size());
+    std::vector<size_t> idx(rank, 0);
+
+    for (size_t n = 0; n < src.size(); n++) {
+
+        // n is the RowMajor offset of idx
+        size_t cm = 0;
+        size_t stride = 1;
+        for (size_t k = 0; k < rank; k++) {
+            cm += idx[k] * stride;
+            stride *= shape[k];
+        }
+        dst[n] = src[cm];
+
+        for (size_t k = rank; k-- > 0;) {
+            if (++idx[k] < shape[k]) {
+                break;
+            }
+            idx[k] = 0;
+        }
+    }
+    return dst;
+}
+
+std::vector<float> sequence(size_t size) {
+    std::vector<float> v(size);
+    for (size_t i = 0; i < size; i++) {
+        v[i] = static_cast<float>(i);
+    }
+    return v;
+}
+
+size_t volume(const std::vector<size_t>& shape) {
+    size_t size = 1;
+    for (auto d : shape) {
+        size *= d;
+    }
+    return size;
+}
+
+const std::vector<std::vector<size_t>> shapes = {
+    {7},
+    {1, 5},
+    {3, 1},
+    {8, 8},
+    {17, 33},
+    {64, 130},
+    {1, 9, 1, 4},
+    {2, 3, 4},
+    {5, 1, 6, 7},
+    {3, 20, 2, 19},
+};
+
+}  // namespace
+
+
+CASE("ColMajor to RowMajor") {
+    for (const auto& shape : shapes) {
+        std::vector<float> src = sequence(volume(shape));
+        std::vector<float> dst(src.size());
+
+        layout::colMajorToRowMajor(src.data(), dst.data(), shape);
+        EXPECT(dst == naiveColMajorToRowMajor(src, shape));
+    }
+}
+
+CASE("RowMajor to ColMajor round-trip") {
+    for (const auto& shape : shapes) {
+        std::vector<float> src = sequence(volume(shape));
+        std::vector<float> tmp(src.size());
+        std::vector<float> dst(src.size());
+
+        layout::colMajorToRowMajor(src.data(), tmp.data(), shape);
+        layout::rowMajorToColMajor(tmp.data(), dst.data(), shape);
+        EXPECT(dst == src);
+    }
+}
+
+CASE("Double precision conversions fused with the re-ordering") {
+    for (const auto& shape : shapes) {
+        std::vector<float> ref = sequence(volume(shape));
+        std::vector<double> src(ref.begin(), ref.end());
+        std::vector<float> tmp(src.size());
+        std::vector<double> dst(src.size());
+
+        layout::colMajorToRowMajor(src.data(), tmp.data(), shape);
+        EXPECT(tmp == naiveColMajorToRowMajor(ref, shape));
+
+        layout::rowMajorToColMajor(tmp.data(), dst.data(), shape);
+        EXPECT(dst == src);
+
+        layout::convert(src.data(), tmp.data(), src.size());
+        EXPECT(tmp == ref);
+
+        layout::convert(tmp.data(), dst.data(), tmp.size());
+        EXPECT(dst == src);
+    }
+}
+
+CASE("Strided 2-D transpose") {
+    size_t rows = 45;
+    size_t cols = 70;
+    size_t lds  = cols + 3;
+    size_t ldd  = rows + 5;
+
+    std::vector<float> src = sequence(rows * lds);
+    std::vector<float> dst(cols * ldd, -1.f);
+
+    layout::transpose2d(src.data(), lds, dst.data(), ldd, rows, cols);
+
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < cols; c++) {
+            EXPECT(dst[c * ldd + r] == src[r * lds + c]);
+        }
+    }
+
+    // padding of dst untouched
+    for (size_t c = 0; c < cols; c++) {
+        for (size_t r = rows; r < ldd; r++) {
+            EXPECT(dst[c * ldd + r] == -1.f);
+        }
+    }
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}
@@ -0,0 +1,269 @@
+/*
+ * (C) Copyright 1996- ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ * In applying this licence, ECMWF does not waive the privileges and immunities
+ * granted to it by virtue of its status as an intergovernmental organisation
+ * nor does it submit to any jurisdiction.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+#include "eckit/linalg/Tensor.h"
+#include "eckit/testing/Test.h"
+
+#include "infero/models/InferenceExecutor.h"
+#include "infero/models/TiledInference.h"
+
+using namespace eckit::testing;
+using namespace infero;
+
+using eckit::linalg::TensorFloat;
+
+namespace test {
+
+namespace {
+
+void fill(TensorFloat& t) {
+    for (size_t i = 0; i < t.size(); i++) {
+        t.data()[i] = static_cast<float>(i % 101) * 0.5f;
+    }
+}
+
+/// pixel-wise "model": out = 2 * in (tiles must be stitched back seamlessly)
+void twice(TensorFloat& in, TensorFloat& out) {
+    EXPECT(in.size() == out.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        out.data()[i] = 2.f * in.data()[i];
+    }
+}
+
+bool isTwice(const TensorFloat& in, const TensorFloat& out) {
+    for (size_t i = 0; i < in.size(); i++) {
+        if (std::abs(out.data()[i] - 2.f * in.data()[i]) > 1e-4f * (1.f + std::abs(in.data()[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// pixel-wise "model" mixing the channels, [b, h, w, 3] -> [b, h, w, 2]
+void mix(TensorFloat& in, TensorFloat& out) {
+    size_t pixels = in.size() / 3;
+    EXPECT(out.size() == pixels * 2);
+    for (size_t p = 0; p < pixels; p++) {
+        const float* i = in.data() + p * 3;
+        out.data()[p * 2]     = i[0] + 2.f * i[1] + 3.f * i[2];
+        out.data()[p * 2 + 1] = i[0] - i[2];
+    }
+}
+
+}  // namespace
+
+
+CASE("Tiles cover the field, the last one aligned to its edge") {
+
+    TiledInference tiler(16, 16, 4, TiledInference::Blend::Linear, 1);
+
+    EXPECT(tiler.tileStarts(16, 16) == std::vector<size_t>({0}));
+    EXPECT(tiler.tileStarts(10, 16) == std::vector<size_t>({0}));
+    EXPECT(tiler.tileStarts(40, 16) == std::vector<size_t>({0, 12, 24}));
+    EXPECT(tiler.tileStarts(37, 16) == std::vector<size_t>({0, 12, 21}));
+
+    // feathering over the overlap
+    EXPECT(tiler.weight(0, 16) == 0.2f);
+    EXPECT(tiler.weight(15, 16) == 0.2f);
+    EXPECT(tiler.weight(8, 16) == 1.f);
+}
+
+
+CASE("Blend weights across a tile") {
+
+    auto profile = [](TiledInference::Blend blend) {
+        TiledInference tiler(8, 8, 4, blend, 1);
+        std::vector<float> w;
+        for (size_t i = 0; i < 8; i++) {
+            w.push_back(tiler.weight(i, 8));
+        }
+        return w;
+    };
+
+    auto near = [](const std::vector<float>& a, const std::vector<float>& b) {
+        for (size_t i = 0; i < a.size(); i++) {
+            if (std::abs(a[i] - b[i]) > 1e-5f) {
+                return false;
+            }
+        }
+        return a.size() == b.size();
+    };
+
+    EXPECT(near(profile(TiledInference::Blend::Average), {1, 1, 1, 1, 1, 1, 1, 1}));
+    EXPECT(near(profile(TiledInference::Blend::Linear), {0.2f, 0.4f, 0.6f, 0.8f, 0.8f, 0.6f, 0.4f, 0.2f}));
+
+    // (the halo keeps a tiny weight, for the field edges no other tile covers)
+    std::vector<float> crop = profile(TiledInference::Blend::Crop);
+    EXPECT(near(crop, {0, 0, 1, 1, 1, 1, 0, 0}));
+    EXPECT(crop[0] > 0.f && crop[7] > 0.f);
+}
+
+
+CASE("Overlapping tiles are blended with their weights") {
+
+    // "model" returning the column of each pixel within its tile: two 8 x 8
+    // tiles at x0 = 0 and 4 overlap over columns 4..7, where the output is the
+    // weighted mean of x (first tile) and x - 4 (second tile)
+    auto column = [](TensorFloat& in, TensorFloat& out) {
+        const std::vector<size_t>& shape = out.shape();
+        for (size_t i = 0; i < out.size(); i++) {
+            out.data()[i] = static_cast<float>((i / shape[3]) % shape[2]);
+        }
+    };
+
+    std::vector<std::pair<TiledInference::Blend, std::vector<float>>> expected{
+        {TiledInference::Blend::Average, {0, 1, 2, 3, 2, 3, 4, 5, 4, 5, 6, 7}},
+        {TiledInference::Blend::Linear, {0, 1, 2, 3, 3.2f, 3.4f, 3.6f, 3.8f, 4, 5, 6, 7}},
+        {TiledInference::Blend::Crop, {0, 1, 2, 3, 4, 5, 2, 3, 4, 5, 6, 7}}};
+
+    for (const auto& e : expected) {
+
+        TiledInference tiler(8, 8, 4, e.first, 2);
+
+        TensorFloat tIn({1, 8, 12, 1});
+        TensorFloat tOut({1, 8, 12, 1});
+        fill(tIn);
+        tiler.infer(tIn, tOut, column, 1);
+
+        bool same = true;
+        for (size_t y = 0; y < 8; y++) {
+            for (size_t x = 0; x < 12; x++) {
+                same = same && std::abs(tOut.data()[y * 12 + x] - e.second[x]) < 1e-4f;
+            }
+        }
+        EXPECT(same);
+    }
+}
+
+
+CASE("Stitched outputs match the untiled model, for all blend modes") {
+
+    for (auto blend : {TiledInference::Blend::Average, TiledInference::Blend::Linear, TiledInference::Blend::Crop}) {
+
+        TiledInference tiler(16, 12, 4, blend, 3);
+
+        TensorFloat tIn({2, 37, 53, 3});
+        TensorFloat tOut({2, 37, 53, 3});
+        fill(tIn);
+
+        tiler.infer(tIn, tOut, twice, 4);
+        EXPECT(isTwice(tIn, tOut));
+
+        // batches shared with the tasks of an executor
+        InferenceExecutor executor(3);
+        TensorFloat tOutPar({2, 37, 53, 3});
+        tiler.infer(tIn, tOutPar, twice, 4, &executor);
+        EXPECT(isTwice(tIn, tOutPar));
+    }
+}
+
+
+CASE("A busy executor leaves all the batches to the calling thread") {
+
+    TiledInference tiler(8, 8, 2, TiledInference::Blend::Average, 1);
+
+    TensorFloat tIn({1, 30, 30, 3});
+    TensorFloat tOut({1, 30, 30, 3});
+    fill(tIn);
+
+    // (the helpers get queued behind a task that only ends afterwards)
+    InferenceExecutor executor(1);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::future<void> busy            = executor.submit([released] { released.wait(); });
+
+    tiler.infer(tIn, tOut, twice, 4, &executor);
+    EXPECT(isTwice(tIn, tOut));
+
+    release.set_value();
+    busy.get();
+    executor.drain();
+}
+
+
+CASE("ColMajor tensors and fields smaller than a tile") {
+
+    TiledInference tiler(32, 32, 8, TiledInference::Blend::Linear, 2);
+
+    TensorFloat tIn({1, 20, 45, 2}, TensorFloat::Layout::ColMajor);
+    TensorFloat tOut({1, 20, 45, 2}, TensorFloat::Layout::ColMajor);
+    fill(tIn);
+
+    tiler.infer(tIn, tOut, twice, 2);
+    EXPECT(isTwice(tIn, tOut));
+
+    // channels gathered and scattered with the ColMajor strides
+    TiledInference mixing(8, 16, 4, TiledInference::Blend::Linear, 3);
+
+    size_t N = 2, H = 21, W = 35;
+    TensorFloat tInRow({N, H, W, 3});
+    TensorFloat tOutRow({N, H, W, 2});
+    fill(tInRow);
+    mixing.infer(tInRow, tOutRow, mix, 1);
+
+    TensorFloat tInCol({N, H, W, 3}, TensorFloat::Layout::ColMajor);
+    TensorFloat tOutCol({N, H, W, 2}, TensorFloat::Layout::ColMajor);
+    for (size_t n = 0; n < N; n++) {
+        for (size_t y = 0; y < H; y++) {
+            for (size_t x = 0; x < W; x++) {
+                for (size_t c = 0; c < 3; c++) {
+                    tInCol.data()[((c * W + x) * H + y) * N + n] = tInRow.data()[((n * H + y) * W + x) * 3 + c];
+                }
+            }
+        }
+    }
+    mixing.infer(tInCol, tOutCol, mix, 1);
+
+    bool same = true;
+    for (size_t n = 0; n < N; n++) {
+        for (size_t y = 0; y < H; y++) {
+            for (size_t x = 0; x < W; x++) {
+                for (size_t c = 0; c < 2; c++) {
+                    float row = tOutRow.data()[((n * H + y) * W + x) * 2 + c];
+                    float col = tOutCol.data()[((c * W + x) * H + y) * N + n];
+                    same      = same && std::abs(row - col) <= 1e-4f * (1.f + std::abs(row));
+                }
+            }
+        }
+    }
+    EXPECT(same);
+}
+
+
+CASE("Engine errors are rethrown") {
+
+    TiledInference tiler(8, 8, 2, TiledInference::Blend::Average, 1);
+
+    TensorFloat tIn({1, 30, 30, 1});
+    TensorFloat tOut({1, 30, 30, 1});
+
+    auto failing = [](TensorFloat&, TensorFloat&) { throw eckit::SeriousBug("engine failure", Here()); };
+    EXPECT_THROWS_AS(tiler.infer(tIn, tOut, failing, 3), eckit::SeriousBug);
+
+    InferenceExecutor executor(2);
+    EXPECT_THROWS_AS(tiler.infer(tIn, tOut, failing, 3, &executor), eckit::SeriousBug);
+
+    TensorFloat tOutSmall({1, 15, 15, 1});
+    EXPECT_THROWS_AS(tiler.infer(tIn, tOutSmall, twice, 1), eckit::BadValue);
+}
+
+}  // namespace test
+
+
+int main(int argc, char** argv) {
+    return run_tests(argc, argv);
+}